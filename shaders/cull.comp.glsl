@@ -0,0 +1,240 @@
+#version 460 core
+
+// Culls the school and picks each fish's level of detail on the GPU (src/cull/gpu_culler.hpp).
+// The default pass runs one invocation per fish, tests it against both eyes' frusta and
+// optionally the depth pyramid of the frame before, and appends the visible ones to their
+// level's range of the instance order; WRITE_COMMANDS runs one per indirect command afterwards
+// and turns the per level counts into instance counts, so nothing is read back to the CPU.
+
+layout (local_size_x = 64) in;
+
+struct FishInstance
+{
+    mat4 model;
+    vec4 params;
+};
+
+// Laid out as in src/model/model.h; five uints, so std430 packs it the same way
+struct DrawElementsIndirectCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Instances
+{
+    FishInstance instances[];
+};
+
+// Level l's fish are written from l * fishCount on
+layout (std430, binding = 1) writeonly buffer InstanceOrder
+{
+    uint instanceOrder[];
+};
+
+// Each fish's level from the frame before, for the hysteresis
+layout (std430, binding = 2) buffer InstanceLevels
+{
+    uint instanceLevels[];
+};
+
+// Fish the depth pyramid hid and visible fish per level, cleared before every cull pass
+layout (std430, binding = 3) buffer LevelCounts
+{
+    uint occludedCount;
+    uint levelCounts[];
+};
+
+layout (std430, binding = 4) buffer Commands
+{
+    DrawElementsIndirectCommand commands[];
+};
+
+layout (std140, binding = 0) uniform StereoCamera
+{
+    mat4 views[2];
+    mat4 projections[2];
+    mat4 skyViews[2];
+};
+
+uniform int fishCount;
+uniform int lodCount;
+
+#ifdef WRITE_COMMANDS
+uniform int meshCount;
+uniform int viewCount;
+
+void main()
+{
+    uint command = gl_GlobalInvocationID.x;
+    if (command >= uint(lodCount * meshCount))
+        return;
+
+    // Commands are level major, every mesh of a level draws the same fish
+    uint level = command / uint(meshCount);
+    commands[command].instanceCount = levelCounts[level] * uint(viewCount);
+    commands[command].baseInstance = level * uint(fishCount);
+}
+#else
+// Object space bounding sphere of the model, and how far the swim animation reaches past it
+uniform vec4 boundsSphere;
+uniform float swimAmplitude;
+uniform vec3 viewPosition;
+uniform float pixelsPerUnit;
+uniform float errorPixels;
+uniform float hysteresis;
+// Object space error of levels 0 to 3, never decreasing (MAX_LOD_LEVELS in src/model/mesh_simplifier.h)
+uniform vec4 lodErrors;
+
+// Occlusion against the depth pyramid (src/cull/depth_pyramid.hpp), whose layers hold the
+// frame before: off, a test per eye, or one test both eyes share on their merged layer
+const int OCCLUSION_OFF = 0;
+const int OCCLUSION_PER_EYE = 1;
+const int OCCLUSION_SHARED = 2;
+uniform int occlusionMode;
+layout (binding = 16) uniform sampler2DArray depthPyramid;
+uniform ivec2 pyramidEyeSize;
+uniform int pyramidLevels;
+uniform mat4 pyramidViewProjections[2];
+// Half the object space bounding box around boundsSphere.xyz
+uniform vec3 boundsExtent;
+
+// Both eyes' planes, extracted once per workgroup: left, right, bottom, top, near, far
+shared vec4 planes[12];
+
+bool insideEye(int eye, vec3 center, float radius)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        vec4 plane = planes[eye * 6 + i];
+        if (dot(plane.xyz, center) + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+// Screen rectangle (min xy, max xy, 0 to 1) and nearest depth of the box in one of the
+// pyramid's eyes. False when any of it falls outside that eye's view, where nothing was drawn
+// that could hide it.
+bool projectBox(mat4 modelViewProjection, vec3 extent, out vec4 rect, out float nearest)
+{
+    rect = vec4(1.0, 1.0, -1.0, -1.0);
+    nearest = 1.0;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        vec3 side = vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1) * 2.0 - 1.0;
+        vec4 clip = modelViewProjection * vec4(boundsSphere.xyz + side * extent, 1.0);
+        if (clip.w <= 0.0)
+            return false;
+        vec3 ndc = clip.xyz / clip.w;
+        rect.xy = min(rect.xy, ndc.xy);
+        rect.zw = max(rect.zw, ndc.xy);
+        nearest = min(nearest, ndc.z * 0.5 + 0.5);
+    }
+    rect = rect * 0.5 + 0.5;
+    return all(greaterThanEqual(rect.xy, vec2(0.0))) && all(lessThanEqual(rect.zw, vec2(1.0)));
+}
+
+// Whether the box lies behind everything drawn under its rectangle: climbs the pyramid until
+// the rectangle spans at most 2x2 texels, so four fetches cover it
+bool hidden(vec4 rect, float nearest, int layer)
+{
+    // Level 0 texels cover 2x2 pixels, each level above twice as many across
+    ivec2 lastPixel = pyramidEyeSize - 1;
+    ivec2 low = clamp(ivec2(rect.xy * vec2(pyramidEyeSize)), ivec2(0), lastPixel) >> 1;
+    ivec2 high = clamp(ivec2(rect.zw * vec2(pyramidEyeSize)), ivec2(0), lastPixel) >> 1;
+    int level = 0;
+    while (level + 1 < pyramidLevels && any(greaterThan(high - low, ivec2(1))))
+    {
+        low >>= 1;
+        high >>= 1;
+        level++;
+    }
+
+    float farthest = max(max(texelFetch(depthPyramid, ivec3(low.x, low.y, layer), level).r,
+                             texelFetch(depthPyramid, ivec3(high.x, low.y, layer), level).r),
+                         max(texelFetch(depthPyramid, ivec3(low.x, high.y, layer), level).r,
+                             texelFetch(depthPyramid, ivec3(high.x, high.y, layer), level).r));
+    return nearest > farthest;
+}
+
+// Per eye the fish has to be hidden in every eye whose frustum it is in. Shared tests the
+// union of those eyes' rectangles once against the merged layer, which holds the farther of
+// the two eyes at every texel, so whatever it hides is hidden from both.
+bool occluded(mat4 model, vec3 extent, bool inEye[2])
+{
+    vec4 merged = vec4(1.0, 1.0, 0.0, 0.0);
+    float mergedNearest = 1.0;
+    for (int eye = 0; eye < 2; eye++)
+    {
+        if (!inEye[eye])
+            continue;
+        vec4 rect;
+        float nearest;
+        if (!projectBox(pyramidViewProjections[eye] * model, extent, rect, nearest))
+            return false;
+        if (occlusionMode == OCCLUSION_PER_EYE && !hidden(rect, nearest, eye))
+            return false;
+        merged = vec4(min(merged.xy, rect.xy), max(merged.zw, rect.zw));
+        mergedNearest = min(mergedNearest, nearest);
+    }
+    return occlusionMode == OCCLUSION_PER_EYE || hidden(merged, mergedNearest, 0);
+}
+
+uint coarsest(float pixelsPerObjectUnit, float limit)
+{
+    uint level = 0u;
+    while (int(level) + 1 < lodCount && lodErrors[level + 1u] * pixelsPerObjectUnit <= limit)
+        level++;
+    return level;
+}
+
+void main()
+{
+    // Gribb and Hartmann, as in src/cull/frustum_culler.cpp
+    if (gl_LocalInvocationIndex < 12u)
+    {
+        int eye = int(gl_LocalInvocationIndex) / 6;
+        int plane = int(gl_LocalInvocationIndex) % 6;
+        mat4 viewProjection = projections[eye] * views[eye];
+        vec4 axis = vec4(viewProjection[0][plane / 2], viewProjection[1][plane / 2], viewProjection[2][plane / 2], viewProjection[3][plane / 2]);
+        vec4 w = vec4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+        vec4 equation = (plane & 1) == 0 ? w + axis : w - axis;
+        planes[gl_LocalInvocationIndex] = equation / length(equation.xyz);
+    }
+    barrier();
+
+    uint fish = gl_GlobalInvocationID.x;
+    if (fish >= uint(fishCount))
+        return;
+
+    mat4 model = instances[fish].model;
+    vec3 center = vec3(model * vec4(boundsSphere.xyz, 1.0));
+    float scale = max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));
+    float radius = boundsSphere.w * scale;
+    float swimRadius = (boundsSphere.w + swimAmplitude) * scale;
+    // A culled fish keeps its level for when it comes back into view
+    bool inEye[2] = bool[2](insideEye(0, center, swimRadius), insideEye(1, center, swimRadius));
+    if (!inEye[0] && !inEye[1])
+        return;
+    if (occlusionMode != OCCLUSION_OFF && occluded(model, boundsExtent + swimAmplitude, inEye))
+    {
+        atomicAdd(occludedCount, 1u);
+        return;
+    }
+
+    // Same selection as LodSelector::select
+    float distance = max(length(center - viewPosition) - radius, 1e-3);
+    float pixelsPerObjectUnit = pixelsPerUnit * scale / distance;
+    uint finest = coarsest(pixelsPerObjectUnit, errorPixels * (1.0 - hysteresis));
+    uint coarse = coarsest(pixelsPerObjectUnit, errorPixels * (1.0 + hysteresis));
+    uint level = clamp(instanceLevels[fish], finest, coarse);
+    instanceLevels[fish] = level;
+
+    uint slot = atomicAdd(levelCounts[level], 1u);
+    instanceOrder[level * uint(fishCount) + slot] = fish;
+}
+#endif
@@ -0,0 +1,56 @@
+#version 460 core
+
+// Builds the depth pyramid for occlusion culling (src/cull/depth_pyramid.hpp) one level per
+// dispatch: every texel keeps the farthest depth of the texels below it. FROM_DEPTH builds
+// level 0 from the eyes' depth buffers, at half their resolution.
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (r32f, binding = 1) writeonly uniform image2DArray destination;
+
+#ifdef FROM_DEPTH
+layout (binding = 16) uniform sampler2DArray eyeDepth;
+// Both eyes reduced into a single layer, for the test shared between them
+uniform bool mergeEyes;
+#else
+layout (r32f, binding = 0) readonly uniform image2DArray source;
+#endif
+
+// Texels in use at either level; the storage is padded past them
+uniform ivec2 sourceSize;
+uniform ivec2 destinationSize;
+
+float farthest(ivec2 texel, int layer)
+{
+    // Sizes round up on the way down, so on odd sizes the last row or column has only one
+    // source texel under it
+    ivec2 first = texel * 2;
+    ivec2 last = min(first + 1, sourceSize - 1);
+    float depth = 0.0;
+    for (int y = first.y; y <= last.y; y++)
+    {
+        for (int x = first.x; x <= last.x; x++)
+        {
+#ifdef FROM_DEPTH
+            depth = max(depth, texelFetch(eyeDepth, ivec3(x, y, layer), 0).r);
+#else
+            depth = max(depth, imageLoad(source, ivec3(x, y, layer)).r);
+#endif
+        }
+    }
+    return depth;
+}
+
+void main()
+{
+    ivec3 texel = ivec3(gl_GlobalInvocationID);
+    if (texel.x >= destinationSize.x || texel.y >= destinationSize.y)
+        return;
+
+    float depth = farthest(texel.xy, texel.z);
+#ifdef FROM_DEPTH
+    if (mergeEyes)
+        depth = max(depth, farthest(texel.xy, 1));
+#endif
+    imageStore(destination, texel, vec4(depth));
+}
@@ -3,9 +3,10 @@ out vec4 FragColor;
   
 in vec2 TexCoords;
 
-uniform sampler2D screenTexture;
+uniform sampler2DArray screenTexture;
+uniform int layer;
 
 void main()
 { 
-    FragColor = texture(screenTexture, TexCoords);
+    FragColor = texture(screenTexture, vec3(TexCoords, layer));
 }
@@ -2,20 +2,9 @@
 
 struct Material
 {
-    sampler2D texture_diffuse1;
-    sampler2D texture_specular1;
     float shininess;
 };
 
-struct Light 
-{
-    vec3 position;
-  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
 in vec3 Normal;
 in vec3 FragPos;
 in vec2 TexCoords;
@@ -27,21 +16,33 @@ out vec4 FragColor;
 // uniform vec3 lightColour;
 
 uniform Material material;
-uniform Light light;
+
+// Units match MaterialSlot in src/model/mesh.h. Every draw of a multi-draw shares the material,
+// since gl_DrawID is not dynamically uniform here and cannot index a sampler array.
+layout (binding = 0) uniform sampler2D diffuseMap;
+layout (binding = 1) uniform sampler2D specularMap;
+
+layout (std140, binding = 2) uniform Light
+{
+    vec4 position;
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+} light;
 
 void main()
 {
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
+    vec3 ambient = light.ambient.rgb * vec3(texture(diffuseMap, TexCoords));
 
     vec3 norm = normalize(Normal);
     vec3 lightDir = normalize(LightPos - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
+    vec3 diffuse = light.diffuse.rgb * diff * vec3(texture(diffuseMap, TexCoords));
 
     vec3 viewDir = normalize(-FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+    vec3 specular = light.specular.rgb * spec * vec3(texture(specularMap, TexCoords));
 
     vec3 result = ambient + diffuse + specular;
     FragColor = vec4(result, 1.0);
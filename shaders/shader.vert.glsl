@@ -1,25 +1,109 @@
 #version 460 core
 
+#ifdef SINGLE_PASS_STEREO
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
+#endif
+
+#ifdef COMPACT_VERTICES
+// Positions are unorm within the mesh bounds, normals octahedral in xy (src/model/mesh.h)
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+// Per draw of a multi-draw, indexed by gl_DrawID (MAX_MULTI_DRAW_MESHES in src/model/mesh.h)
+uniform vec3 positionOffset[8];
+uniform vec3 positionScale[8];
+#else
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+#endif
 
 out vec3 Normal;
 out vec3 FragPos;
 out vec2 TexCoords;
 out vec3 LightPos;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform float _Time;
+struct FishInstance
+{
+    mat4 model;
+    vec4 params;
+};
 
-uniform vec3 offsets[100];
+layout (std430, binding = 0) readonly buffer Instances
+{
+    FishInstance instances[];
+};
 
-in vec3 lightPos;
+// Instances grouped by level of detail (src/lod/lod_selector.hpp); each level's draws start
+// at its group through gl_BaseInstance
+layout (std430, binding = 1) readonly buffer InstanceOrder
+{
+    uint instanceOrder[];
+};
+
+layout (std140, binding = 0) uniform StereoCamera
+{
+    mat4 views[2];
+    mat4 projections[2];
+    mat4 skyViews[2];
+};
+
+layout (std140, binding = 1) uniform Frame
+{
+    float _Time;
+};
+
+layout (std140, binding = 2) uniform Light
+{
+    vec4 position;
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+} light;
+
+#ifndef SINGLE_PASS_STEREO
+layout (std140, binding = 3) uniform EyeSelect
+{
+    int selectedEye;
+};
+#endif
+
+#ifdef COMPACT_VERTICES
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+#endif
 
 void main()
 {
+#ifdef COMPACT_VERTICES
+    // Decoded to object space here rather than in the model matrix, the swim wave reads object z
+    vec3 position = positionOffset[gl_DrawID] + positionScale[gl_DrawID] * aPos;
+    vec3 normal = octahedralDecode(aNormal.xy);
+#else
+    vec3 position = aPos;
+    vec3 normal = aNormal;
+#endif
+
+#ifdef SINGLE_PASS_STEREO
+    // Instances are doubled: even instances draw to the left eye layer, odd to the right.
+    int eye = gl_InstanceID & 1;
+    int instanceIndex = int(instanceOrder[gl_BaseInstance + (gl_InstanceID >> 1)]);
+    gl_Layer = eye;
+#else
+    int eye = selectedEye;
+    int instanceIndex = int(instanceOrder[gl_BaseInstance + gl_InstanceID]);
+#endif
+    mat4 eyeView = views[eye];
+    mat4 eyeProjection = projections[eye];
+
     float _EffectRadius = 0.5;
     float _WaveSpeed = 10.0;
     float _WaveHeight = 0.07;
@@ -28,22 +112,24 @@ void main()
     int _Threshold = 3;
     float _StrideSpeed = 5.0;
     float _StrideStrength = 0.15;
-    float _MoveOffset = 0.0;
 
-    float sinUse = sin(_Time * _WaveSpeed + _MoveOffset + aPos.z * _WaveDensity);
-    float yValue = -aPos.z + _Yoffset;
+    FishInstance instance = instances[instanceIndex];
+    mat4 model = instance.model;
+    float _MoveOffset = instance.params.x;
+
+    float sinUse = sin(_Time * _WaveSpeed + _MoveOffset + position.z * _WaveDensity);
+    float yValue = -position.z + _Yoffset;
     float yDirScaling = clamp(pow(yValue * _EffectRadius,_Threshold),0.0,1.0);
 
-    vec3 Pos = aPos;
-    Pos.x = aPos.x + sinUse * _WaveHeight * yDirScaling;
+    vec3 Pos = position;
+    Pos.x = position.x + sinUse * _WaveHeight * yDirScaling;
     Pos.x = Pos.x + sin(-_Time * _StrideSpeed + _MoveOffset) * _StrideStrength;
 
-    vec3 offset = offsets[gl_InstanceID];
-    gl_Position = projection * view * model * vec4(Pos + offset, 1.0);
+    gl_Position = eyeProjection * eyeView * model * vec4(Pos, 1.0);
 
-    FragPos = vec3(view * model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(view * model))) * aNormal;
+    FragPos = vec3(eyeView * model * vec4(position, 1.0));
+    Normal = mat3(transpose(inverse(eyeView * model))) * normal;
 
-    LightPos = vec3(view * vec4(lightPos, 1.0));
+    LightPos = vec3(eyeView * vec4(light.position.xyz, 1.0));
     TexCoords = aTexCoords;
 }
@@ -1,14 +1,38 @@
 #version 460 core
+
+#ifdef SINGLE_PASS_STEREO
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
+#endif
+
 layout(location = 0) in vec3 aPos;
 
 out vec3 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140, binding = 0) uniform StereoCamera
+{
+    mat4 views[2];
+    mat4 projections[2];
+    mat4 skyViews[2];
+};
+
+#ifndef SINGLE_PASS_STEREO
+layout (std140, binding = 3) uniform EyeSelect
+{
+    int selectedEye;
+};
+#endif
 
 void main()
 {
+#ifdef SINGLE_PASS_STEREO
+    int eye = gl_InstanceID;
+    gl_Layer = eye;
+#else
+    int eye = selectedEye;
+#endif
+
     TexCoords = aPos;
-    vec4 pos = projection * view * vec4(aPos, 1.0);
+    vec4 pos = projections[eye] * skyViews[eye] * vec4(aPos, 1.0);
     gl_Position = pos.xyww;
 }
@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "benchmark.hpp"
+
+std::vector<BenchmarkConfig> benchmarkSweep(const Options& options)
+{
+    std::vector<unsigned int> fishCounts = options.benchFishCounts;
+    if (fishCounts.empty())
+        fishCounts.push_back(options.fishCount);
+
+    std::vector<EyeResolution> resolutions = options.benchResolutions;
+    if (resolutions.empty())
+        resolutions.push_back(options.eyeResolution);
+
+    std::vector<StereoMode> stereoModes = options.benchStereoModes;
+    if (stereoModes.empty())
+        stereoModes.push_back(options.stereoMode);
+
+    std::vector<BenchmarkConfig> configs;
+    for (StereoMode mode : stereoModes)
+        for (const EyeResolution& resolution : resolutions)
+            for (unsigned int fishCount : fishCounts)
+                configs.push_back({ fishCount, resolution.width, resolution.height, mode });
+    return configs;
+}
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    // Nearest rank, so every reported value is an actual frame
+    size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+FrameStats computeFrameStats(std::vector<double> samples)
+{
+    FrameStats stats = {};
+    if (samples.empty())
+        return stats;
+
+    std::sort(samples.begin(), samples.end());
+    double total = 0.0;
+    for (double sample : samples)
+        total += sample;
+
+    stats.min = samples.front();
+    stats.mean = total / samples.size();
+    stats.p50 = percentile(samples, 50.0);
+    stats.p95 = percentile(samples, 95.0);
+    stats.p99 = percentile(samples, 99.0);
+    stats.max = samples.back();
+    return stats;
+}
+
+void setGpuFrameStats(BenchmarkResult& result, const std::vector<GpuFrameTimes>& gpuTimes)
+{
+    std::vector<double> totals;
+    std::vector<double> passes[GPU_PASS_COUNT];
+    for (const GpuFrameTimes& times : gpuTimes)
+    {
+        totals.push_back(times.totalMs);
+        for (int pass = 0; pass < GPU_PASS_COUNT; pass++)
+            if (times.passUsed[pass])
+                passes[pass].push_back(times.passMs[pass]);
+    }
+
+    result.hasGpu = !totals.empty();
+    result.gpu = computeFrameStats(totals);
+    for (int pass = 0; pass < GPU_PASS_COUNT; pass++)
+    {
+        result.hasPass[pass] = !passes[pass].empty();
+        result.passes[pass] = computeFrameStats(passes[pass]);
+    }
+}
+
+const char* stereoModeName(StereoMode mode)
+{
+    return mode == STEREO_SINGLE_PASS ? "single-pass" : "two-pass";
+}
+
+void printBenchmarkResult(const BenchmarkResult& result)
+{
+    const BenchmarkConfig& config = result.config;
+    std::cout << std::fixed << std::setprecision(3)
+              << "Benchmark " << stereoModeName(config.stereoMode) << " " << config.eyeWidth << "x" << config.eyeHeight
+              << " " << config.fishCount << " fish: cpu mean " << result.cpu.mean << " ms, p50 " << result.cpu.p50
+              << " ms, p99 " << result.cpu.p99 << " ms";
+    if (result.hasGpu)
+        std::cout << ", gpu mean " << result.gpu.mean << " ms, p99 " << result.gpu.p99 << " ms";
+    std::cout << std::endl;
+
+    for (int pass = 0; pass < GPU_PASS_COUNT; pass++)
+        if (result.hasPass[pass])
+            std::cout << "    " << gpuPassName((GpuPass)pass) << ": gpu mean " << result.passes[pass].mean
+                      << " ms, p99 " << result.passes[pass].p99 << " ms" << std::endl;
+    std::cout << std::defaultfloat;
+}
+
+static std::string jsonString(const std::string& text)
+{
+    std::string escaped = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        if ((unsigned char)c >= 0x20)
+            escaped += c;
+    }
+    return escaped + "\"";
+}
+
+static void writeStatsJson(std::ofstream& file, const FrameStats& stats)
+{
+    file << "{ \"min\": " << stats.min << ", \"mean\": " << stats.mean << ", \"p50\": " << stats.p50
+         << ", \"p95\": " << stats.p95 << ", \"p99\": " << stats.p99 << ", \"max\": " << stats.max << " }";
+}
+
+bool writeBenchmarkJson(const std::string& path, const BenchmarkReport& report)
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cout << "ERROR::BENCHMARK::FILE_NOT_WRITTEN " << path << std::endl;
+        return false;
+    }
+
+    file << std::setprecision(6);
+    file << "{\n"
+         << "  \"renderer\": " << jsonString(report.renderer) << ",\n"
+         << "  \"version\": " << jsonString(report.version) << ",\n"
+         << "  \"camera_path\": " << jsonString(report.cameraPath) << ",\n"
+         << "  \"frames\": " << report.frames << ",\n"
+         << "  \"warmup_frames\": " << report.warmupFrames << ",\n"
+         << "  \"runs\": [\n";
+
+    for (size_t i = 0; i < report.results.size(); i++)
+    {
+        const BenchmarkResult& result = report.results[i];
+        file << "    { \"fish\": " << result.config.fishCount
+             << ", \"eye_width\": " << result.config.eyeWidth
+             << ", \"eye_height\": " << result.config.eyeHeight
+             << ", \"stereo\": " << jsonString(stereoModeName(result.config.stereoMode))
+             << ",\n      \"cpu_frame_ms\": ";
+        writeStatsJson(file, result.cpu);
+        file << ",\n      \"gpu_frame_ms\": ";
+        if (result.hasGpu)
+            writeStatsJson(file, result.gpu);
+        else
+            file << "null";
+
+        file << ",\n      \"gpu_pass_ms\": {";
+        bool first = true;
+        for (int pass = 0; pass < GPU_PASS_COUNT; pass++)
+        {
+            if (!result.hasPass[pass])
+                continue;
+            file << (first ? "\n" : ",\n") << "        " << jsonString(gpuPassName((GpuPass)pass)) << ": ";
+            writeStatsJson(file, result.passes[pass]);
+            first = false;
+        }
+        file << (first ? "}" : "\n      }");
+        file << " }" << (i + 1 < report.results.size() ? "," : "") << "\n";
+    }
+
+    file << "  ]\n}\n";
+    return true;
+}
+
+static void writeStatsCsv(std::ofstream& file, const FrameStats& stats)
+{
+    file << stats.min << ',' << stats.mean << ',' << stats.p50 << ',' << stats.p95 << ',' << stats.p99 << ',' << stats.max;
+}
+
+bool writeBenchmarkCsv(const std::string& path, const BenchmarkReport& report)
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cout << "ERROR::BENCHMARK::FILE_NOT_WRITTEN " << path << std::endl;
+        return false;
+    }
+
+    file << std::setprecision(6);
+    file << "fish,eye_width,eye_height,stereo,frames,"
+         << "cpu_min_ms,cpu_mean_ms,cpu_p50_ms,cpu_p95_ms,cpu_p99_ms,cpu_max_ms,"
+         << "gpu_min_ms,gpu_mean_ms,gpu_p50_ms,gpu_p95_ms,gpu_p99_ms,gpu_max_ms";
+    // Per pass columns keep the CSV narrow: mean and tail only, the JSON has everything
+    for (int pass = 0; pass < GPU_PASS_COUNT; pass++)
+    {
+        const char* name = gpuPassName((GpuPass)pass);
+        file << ',' << name << "_mean_ms," << name << "_p95_ms," << name << "_p99_ms";
+    }
+    file << '\n';
+
+    for (const BenchmarkResult& result : report.results)
+    {
+        file << result.config.fishCount << ',' << result.config.eyeWidth << ',' << result.config.eyeHeight << ','
+             << stereoModeName(result.config.stereoMode) << ',' << result.frames << ',';
+        writeStatsCsv(file, result.cpu);
+        file << ',';
+        if (result.hasGpu)
+            writeStatsCsv(file, result.gpu);
+        else
+            file << ",,,,,";
+        for (int pass = 0; pass < GPU_PASS_COUNT; pass++)
+        {
+            if (result.hasPass[pass])
+                file << ',' << result.passes[pass].mean << ',' << result.passes[pass].p95 << ',' << result.passes[pass].p99;
+            else
+                file << ",,,";
+        }
+        file << '\n';
+    }
+    return true;
+}
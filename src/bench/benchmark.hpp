@@ -0,0 +1,64 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+
+#include "../options/options.hpp"
+#include "gpu_timer.hpp"
+
+// Frames rendered and discarded before each configuration is measured
+const unsigned int BENCHMARK_WARMUP_FRAMES = 30;
+// Animation time advanced per frame, fixed so every run sees the same poses
+const float BENCHMARK_TIME_STEP = 1.0f / 60.0f;
+
+struct BenchmarkConfig
+{
+    unsigned int fishCount;
+    unsigned int eyeWidth;
+    unsigned int eyeHeight;
+    StereoMode stereoMode;
+};
+
+struct FrameStats
+{
+    double min, mean, p50, p95, p99, max;
+};
+
+struct BenchmarkResult
+{
+    BenchmarkConfig config;
+    unsigned int frames;
+    // CPU time to build and submit a frame, excluding the wait for the GPU to finish it
+    FrameStats cpu;
+    bool hasGpu;
+    FrameStats gpu;
+    // Per pass GPU time, for the passes this configuration ran
+    bool hasPass[GPU_PASS_COUNT];
+    FrameStats passes[GPU_PASS_COUNT];
+};
+
+struct BenchmarkReport
+{
+    std::string renderer;
+    std::string version;
+    std::string cameraPath;
+    unsigned int frames;
+    unsigned int warmupFrames;
+    std::vector<BenchmarkResult> results;
+};
+
+// Every combination of the swept fish counts, eye resolutions and stereo modes.
+// Lists left empty in the options fall back to the single interactive setting.
+std::vector<BenchmarkConfig> benchmarkSweep(const Options& options);
+
+FrameStats computeFrameStats(std::vector<double> samples);
+// Fills the GPU frame and per pass statistics, left unset when the timer produced nothing
+void setGpuFrameStats(BenchmarkResult& result, const std::vector<GpuFrameTimes>& gpuTimes);
+const char* stereoModeName(StereoMode mode);
+
+void printBenchmarkResult(const BenchmarkResult& result);
+bool writeBenchmarkJson(const std::string& path, const BenchmarkReport& report);
+bool writeBenchmarkCsv(const std::string& path, const BenchmarkReport& report);
+
+#endif
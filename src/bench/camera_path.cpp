@@ -0,0 +1,107 @@
+#include <iostream>
+#include <sstream>
+
+#include "camera_path.hpp"
+
+bool CameraPath::load(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cout << "ERROR::CAMERA_PATH::FILE_NOT_READ " << path << std::endl;
+        return false;
+    }
+
+    keys.clear();
+    std::string line;
+    unsigned int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream fields(line);
+        CameraKey key;
+        if (!(fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch)
+            || (!keys.empty() && key.time < keys.back().time))
+        {
+            std::cout << "ERROR::CAMERA_PATH::BAD_KEY " << path << ":" << lineNumber << std::endl;
+            return false;
+        }
+        keys.push_back(key);
+    }
+
+    if (keys.empty())
+    {
+        std::cout << "ERROR::CAMERA_PATH::EMPTY " << path << std::endl;
+        return false;
+    }
+
+    name = path;
+    return true;
+}
+
+CameraPath CameraPath::scripted()
+{
+    CameraPath path;
+    path.name = "scripted";
+    path.keys = {
+        {  0.0f, glm::vec3( 0.0f,  0.0f,  3.0f),  -90.0f,  0.0f },
+        {  4.0f, glm::vec3( 3.0f,  1.0f, -2.0f), -110.0f, -8.0f },
+        {  8.0f, glm::vec3( 0.0f, -1.0f, -6.0f),  -90.0f,  5.0f },
+        { 12.0f, glm::vec3(-3.0f,  1.0f, -2.0f),  -70.0f, -8.0f },
+        { 16.0f, glm::vec3( 0.0f,  0.0f,  3.0f),  -90.0f,  0.0f }
+    };
+    return path;
+}
+
+float CameraPath::duration() const
+{
+    return keys.empty() ? 0.0f : keys.back().time - keys.front().time;
+}
+
+void CameraPath::apply(float time, Camera& camera) const
+{
+    if (keys.empty())
+        return;
+
+    time += keys.front().time;
+    size_t next = 0;
+    while (next < keys.size() && keys[next].time < time)
+        next++;
+
+    if (next == 0 || next == keys.size())
+    {
+        const CameraKey& key = next == 0 ? keys.front() : keys.back();
+        camera.SetPose(key.position, key.yaw, key.pitch);
+        return;
+    }
+
+    const CameraKey& a = keys[next - 1];
+    const CameraKey& b = keys[next];
+    float t = b.time > a.time ? (time - a.time) / (b.time - a.time) : 1.0f;
+    camera.SetPose(glm::mix(a.position, b.position, t), glm::mix(a.yaw, b.yaw, t), glm::mix(a.pitch, b.pitch, t));
+}
+
+bool CameraRecorder::open(const std::string& path)
+{
+    file.open(path);
+    if (!file)
+    {
+        std::cout << "ERROR::CAMERA_PATH::FILE_NOT_WRITTEN " << path << std::endl;
+        return false;
+    }
+
+    file << "# time x y z yaw pitch\n";
+    return true;
+}
+
+void CameraRecorder::record(float time, const Camera& camera)
+{
+    if (!file.is_open())
+        return;
+
+    file << time << ' ' << camera.Position.x << ' ' << camera.Position.y << ' ' << camera.Position.z
+         << ' ' << camera.Yaw << ' ' << camera.Pitch << '\n';
+}
@@ -0,0 +1,47 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <glm/glm.hpp>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../camera/camera.hpp"
+
+struct CameraKey
+{
+    float time;
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+};
+
+// Camera poses over time, linearly interpolated between keys. Stored as text, one
+// "time x y z yaw pitch" key per line, which is also what CameraRecorder writes.
+class CameraPath
+{
+public:
+    std::string name;
+    std::vector<CameraKey> keys;
+
+    bool load(const std::string& path);
+    // Built-in flight in front of and through the school, used when no path file is given
+    static CameraPath scripted();
+
+    float duration() const;
+    void apply(float time, Camera& camera) const;
+};
+
+// Appends the camera pose every frame so an interactive session can be replayed as a benchmark.
+class CameraRecorder
+{
+public:
+    bool open(const std::string& path);
+    void record(float time, const Camera& camera);
+
+private:
+    std::ofstream file;
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include <iostream>
+
+#include "gpu_timer.hpp"
+
+GpuPassTimer::GpuPassTimer()
+    : current(nullptr), frameNumber(0), dropped(0), supported(false)
+{
+    for (FrameSlot& slot : ring)
+    {
+        slot.scopeCount = 0;
+        slot.queryCount = 0;
+        slot.frame = 0;
+        slot.pending = false;
+    }
+    for (int& scope : openScopes)
+        scope = -1;
+}
+
+GpuPassTimer::~GpuPassTimer()
+{
+    if (!supported)
+        return;
+    for (FrameSlot& slot : ring)
+        glDeleteQueries(2 * GPU_TIMER_MAX_SCOPES + 2, slot.queries);
+}
+
+bool GpuPassTimer::create()
+{
+    int timestampBits = 0;
+    glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &timestampBits);
+    if (timestampBits == 0)
+    {
+        std::cout << "GPU pass timing disabled, the driver has no timestamp queries" << std::endl;
+        return false;
+    }
+
+    for (FrameSlot& slot : ring)
+        glGenQueries(2 * GPU_TIMER_MAX_SCOPES + 2, slot.queries);
+    supported = true;
+    return true;
+}
+
+unsigned int GpuPassTimer::stamp(FrameSlot& slot)
+{
+    unsigned int index = slot.queryCount++;
+    glQueryCounter(slot.queries[index], GL_TIMESTAMP);
+    return index;
+}
+
+void GpuPassTimer::beginFrame()
+{
+    if (!supported)
+        return;
+
+    // Read back oldest first and stop at the first frame still in flight, so results stay
+    // in order. The slot about to be reused is the oldest one.
+    unsigned int next = frameNumber % GPU_TIMER_RING_SIZE;
+    for (unsigned int i = 0; i < GPU_TIMER_RING_SIZE; i++)
+    {
+        FrameSlot& slot = ring[(next + i) % GPU_TIMER_RING_SIZE];
+        if (slot.pending && !collect(slot, false))
+            break;
+    }
+
+    current = &ring[next];
+    if (current->pending)
+    {
+        current->pending = false;
+        dropped++;
+    }
+
+    current->frame = frameNumber++;
+    current->scopeCount = 0;
+    current->queryCount = 0;
+    for (int& scope : openScopes)
+        scope = -1;
+
+    // Query 0 starts the frame, query 1 is reserved for its end
+    stamp(*current);
+    current->queryCount = 2;
+}
+
+void GpuPassTimer::endFrame()
+{
+    if (!supported || !current)
+        return;
+
+    glQueryCounter(current->queries[1], GL_TIMESTAMP);
+    current->pending = true;
+    current = nullptr;
+}
+
+void GpuPassTimer::begin(GpuPass pass)
+{
+    if (!supported || !current || current->scopeCount == GPU_TIMER_MAX_SCOPES)
+        return;
+
+    Scope& scope = current->scopes[current->scopeCount];
+    scope.pass = pass;
+    scope.beginQuery = stamp(*current);
+    scope.endQuery = scope.beginQuery;
+    openScopes[pass] = current->scopeCount++;
+}
+
+void GpuPassTimer::end(GpuPass pass)
+{
+    if (!supported || !current || openScopes[pass] < 0)
+        return;
+
+    current->scopes[openScopes[pass]].endQuery = stamp(*current);
+    openScopes[pass] = -1;
+}
+
+bool GpuPassTimer::collect(FrameSlot& slot, bool wait)
+{
+    // Timestamps land in submission order, so the frame end being ready means all are
+    if (!wait)
+    {
+        GLint ready = GL_FALSE;
+        glGetQueryObjectiv(slot.queries[1], GL_QUERY_RESULT_AVAILABLE, &ready);
+        if (!ready)
+            return false;
+    }
+
+    GLuint64 stamps[2 * GPU_TIMER_MAX_SCOPES + 2];
+    for (unsigned int i = 0; i < slot.queryCount; i++)
+        glGetQueryObjectui64v(slot.queries[i], GL_QUERY_RESULT, &stamps[i]);
+
+    GpuFrameTimes times = {};
+    times.frame = slot.frame;
+    times.totalMs = (stamps[1] - stamps[0]) / 1.0e6;
+    for (unsigned int i = 0; i < slot.scopeCount; i++)
+    {
+        const Scope& scope = slot.scopes[i];
+        // A scope left open at the end of the frame has no end stamp and is not counted
+        if (scope.endQuery == scope.beginQuery)
+            continue;
+        times.passMs[scope.pass] += (stamps[scope.endQuery] - stamps[scope.beginQuery]) / 1.0e6;
+        times.passUsed[scope.pass] = true;
+    }
+
+    results.push_back(times);
+    slot.pending = false;
+    return true;
+}
+
+void GpuPassTimer::finish()
+{
+    if (!supported)
+        return;
+
+    unsigned int oldest = frameNumber % GPU_TIMER_RING_SIZE;
+    for (unsigned int i = 0; i < GPU_TIMER_RING_SIZE; i++)
+    {
+        FrameSlot& slot = ring[(oldest + i) % GPU_TIMER_RING_SIZE];
+        if (slot.pending)
+            collect(slot, true);
+    }
+}
+
+std::vector<GpuFrameTimes> GpuPassTimer::takeResults()
+{
+    std::vector<GpuFrameTimes> finished;
+    finished.swap(results);
+    return finished;
+}
+
+const char* gpuPassName(GpuPass pass)
+{
+    switch (pass)
+    {
+    case GPU_PASS_LEFT_EYE: return "left_eye";
+    case GPU_PASS_RIGHT_EYE: return "right_eye";
+    case GPU_PASS_BOTH_EYES: return "both_eyes";
+    case GPU_PASS_SKYBOX: return "skybox";
+    case GPU_PASS_FISH: return "fish";
+    case GPU_PASS_COMPOSITE: return "composite";
+    default: return "unknown";
+    }
+}
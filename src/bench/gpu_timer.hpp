@@ -0,0 +1,95 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+#include <vector>
+
+// Frames of queries in flight. Results are read this many frames after they were issued,
+// by which time the GPU has long finished them, so reading never waits on the pipeline.
+const unsigned int GPU_TIMER_RING_SIZE = 4;
+// Timed scopes per frame; a two pass frame uses seven
+const unsigned int GPU_TIMER_MAX_SCOPES = 32;
+
+enum GpuPass
+{
+    GPU_PASS_LEFT_EYE,
+    GPU_PASS_RIGHT_EYE,
+    GPU_PASS_BOTH_EYES,
+    GPU_PASS_SKYBOX,
+    GPU_PASS_FISH,
+    GPU_PASS_COMPOSITE,
+    GPU_PASS_COUNT
+};
+
+// GPU milliseconds for one finished frame. Passes entered several times in a frame, such as
+// the skybox drawn once per eye, are summed; passes never entered read zero.
+struct GpuFrameTimes
+{
+    unsigned long long frame;
+    double totalMs;
+    double passMs[GPU_PASS_COUNT];
+    bool passUsed[GPU_PASS_COUNT];
+};
+
+// Per pass GPU timing from GL_TIMESTAMP queries. Timestamps rather than GL_TIME_ELAPSED so
+// passes can nest, e.g. the skybox inside an eye. Every frame writes its own slot of the
+// ring and the slot is read back when it comes round again.
+class GpuPassTimer
+{
+public:
+    GpuPassTimer();
+    ~GpuPassTimer();
+    GpuPassTimer(const GpuPassTimer&) = delete;
+    GpuPassTimer& operator=(const GpuPassTimer&) = delete;
+
+    // Allocates the queries once a context is current. Without timestamp support every
+    // other call is a no-op and no results are produced.
+    bool create();
+    bool available() const { return supported; }
+
+    void beginFrame();
+    void endFrame();
+    void begin(GpuPass pass);
+    void end(GpuPass pass);
+
+    // Blocks until every issued frame has a result, for the end of a run
+    void finish();
+    // Finished frames since the last call, oldest first
+    std::vector<GpuFrameTimes> takeResults();
+    // Frames whose slot was needed again before their results arrived
+    unsigned long long droppedFrames() const { return dropped; }
+
+private:
+    struct Scope
+    {
+        GpuPass pass;
+        unsigned int beginQuery;
+        unsigned int endQuery;
+    };
+
+    struct FrameSlot
+    {
+        unsigned int queries[2 * GPU_TIMER_MAX_SCOPES + 2];
+        Scope scopes[GPU_TIMER_MAX_SCOPES];
+        unsigned int scopeCount;
+        unsigned int queryCount;
+        unsigned long long frame;
+        bool pending;
+    };
+
+    FrameSlot ring[GPU_TIMER_RING_SIZE];
+    FrameSlot* current;
+    int openScopes[GPU_PASS_COUNT];
+    unsigned long long frameNumber;
+    unsigned long long dropped;
+    std::vector<GpuFrameTimes> results;
+    bool supported;
+
+    unsigned int stamp(FrameSlot& slot);
+    bool collect(FrameSlot& slot, bool wait);
+};
+
+const char* gpuPassName(GpuPass pass);
+
+#endif
@@ -92,6 +92,14 @@ public:
         updateCameraVectors();
     }
 
+    void SetPose(glm::vec3 position, float yaw, float pitch)
+    {
+        Position = position;
+        Yaw = yaw;
+        Pitch = pitch;
+        updateCameraVectors();
+    }
+
     void ProcessMouseScroll(float yoffset)
     {
         Zoom -= (float)yoffset;
@@ -0,0 +1,119 @@
+#include "depth_pyramid.hpp"
+#include "../util/profiler.hpp"
+
+// local_size_x and local_size_y of shaders/depth_pyramid.comp.glsl
+const int PYRAMID_WORKGROUP_SIZE = 8;
+
+// Image units of the source and destination levels in shaders/depth_pyramid.comp.glsl
+const unsigned int PYRAMID_SOURCE_IMAGE = 0;
+const unsigned int PYRAMID_DESTINATION_IMAGE = 1;
+
+static glm::ivec2 halfSize(glm::ivec2 size)
+{
+    return glm::ivec2((size.x + 1) / 2, (size.y + 1) / 2);
+}
+
+static int nextPowerOfTwo(int value)
+{
+    int power = 1;
+    while (power < value)
+        power *= 2;
+    return power;
+}
+
+DepthPyramid::DepthPyramid()
+{
+}
+
+DepthPyramid::~DepthPyramid()
+{
+    glDeleteTextures(1, &texture);
+    if (fromDepthProgram)
+        glDeleteProgram(fromDepthProgram->ID);
+    if (reduceProgram)
+        glDeleteProgram(reduceProgram->ID);
+}
+
+void DepthPyramid::allocate(glm::ivec2 size, int layerCount)
+{
+    glDeleteTextures(1, &texture);
+    eyeSize = size;
+    layers = layerCount;
+
+    glm::ivec2 levelSize = halfSize(size);
+    levels = 1;
+    while (levelSize.x > 1 || levelSize.y > 1)
+    {
+        levelSize = halfSize(levelSize);
+        levels++;
+    }
+
+    // GL halves mip sizes rounding down, so the storage is padded to a power of two, where
+    // that agrees with rounding up; the padding is never written or read
+    glm::ivec2 storageSize(nextPowerOfTwo(halfSize(size).x), nextPowerOfTwo(halfSize(size).y));
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_R32F, storageSize.x, storageSize.y, layers);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void DepthPyramid::build(const EyeTarget& eyes, const StereoCameraBlock& camera, bool shared)
+{
+    PROFILE_ZONE("DepthPyramid::build");
+    if (!fromDepthProgram)
+    {
+        fromDepthProgram.reset(new Shader(Shader::compute("shaders/depth_pyramid.comp.glsl", "#define FROM_DEPTH\n")));
+        reduceProgram.reset(new Shader(Shader::compute("shaders/depth_pyramid.comp.glsl")));
+        fromDepthUniforms.sourceSize = fromDepthProgram->uniform<glm::ivec2>("sourceSize");
+        fromDepthUniforms.destinationSize = fromDepthProgram->uniform<glm::ivec2>("destinationSize");
+        reduceUniforms.sourceSize = reduceProgram->uniform<glm::ivec2>("sourceSize");
+        reduceUniforms.destinationSize = reduceProgram->uniform<glm::ivec2>("destinationSize");
+        mergeEyes = fromDepthProgram->uniform<bool>("mergeEyes");
+    }
+
+    glm::ivec2 size(eyes.width, eyes.height);
+    int layerCount = shared ? 1 : 2;
+    if (!texture || size != eyeSize || layerCount != layers)
+        allocate(size, layerCount);
+
+    for (int eye = 0; eye < 2; eye++)
+        viewProjections[eye] = camera.projections[eye] * camera.views[eye];
+
+    glm::ivec2 sourceSize = size;
+    glm::ivec2 levelSize = halfSize(size);
+
+    fromDepthProgram->use();
+    fromDepthProgram->set(mergeEyes, shared);
+    fromDepthProgram->set(fromDepthUniforms.sourceSize, sourceSize);
+    fromDepthProgram->set(fromDepthUniforms.destinationSize, levelSize);
+    glActiveTexture(GL_TEXTURE0 + DEPTH_PYRAMID_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, eyes.depthTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindImageTexture(PYRAMID_DESTINATION_IMAGE, texture, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32F);
+    glDispatchCompute((levelSize.x + PYRAMID_WORKGROUP_SIZE - 1) / PYRAMID_WORKGROUP_SIZE, (levelSize.y + PYRAMID_WORKGROUP_SIZE - 1) / PYRAMID_WORKGROUP_SIZE, layers);
+
+    reduceProgram->use();
+    for (int level = 1; level < levels; level++)
+    {
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        sourceSize = levelSize;
+        levelSize = halfSize(levelSize);
+        reduceProgram->set(reduceUniforms.sourceSize, sourceSize);
+        reduceProgram->set(reduceUniforms.destinationSize, levelSize);
+        glBindImageTexture(PYRAMID_SOURCE_IMAGE, texture, level - 1, GL_TRUE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(PYRAMID_DESTINATION_IMAGE, texture, level, GL_TRUE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((levelSize.x + PYRAMID_WORKGROUP_SIZE - 1) / PYRAMID_WORKGROUP_SIZE, (levelSize.y + PYRAMID_WORKGROUP_SIZE - 1) / PYRAMID_WORKGROUP_SIZE, layers);
+    }
+
+    // The cull pass reads it with texelFetch
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void DepthPyramid::bind() const
+{
+    glActiveTexture(GL_TEXTURE0 + DEPTH_PYRAMID_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,60 @@
+#ifndef DEPTH_PYRAMID_H
+#define DEPTH_PYRAMID_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <memory>
+
+#include "../scene/scene_buffers.hpp"
+#include "../shader/shader.hpp"
+#include "../stereo/eye_target.hpp"
+
+// Texture unit the pyramid is read from, clear of the material units (MaterialSlot in src/model/mesh.h)
+const unsigned int DEPTH_PYRAMID_UNIT = 16;
+
+// Hierarchical depth (Hi-Z) of a rendered frame for occlusion culling. Level 0 is half the eye
+// resolution and each level above halves it again, rounding up, down to 1x1; every texel holds
+// the farthest depth under it, so whatever lies behind that depth across the texel is hidden.
+// One layer per eye, or a single layer holding the farther of the two eyes for a test both
+// eyes can share.
+class DepthPyramid
+{
+public:
+    DepthPyramid();
+    ~DepthPyramid();
+    DepthPyramid(const DepthPyramid&) = delete;
+    DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+    // Reduces the depth the eyes were just drawn with and keeps the view projections that
+    // drew it, so instances can be projected into that frame next time round
+    void build(const EyeTarget& eyes, const StereoCameraBlock& camera, bool shared);
+    void bind() const;
+
+    // False until the first build
+    bool isBuilt() const { return texture != 0; }
+    bool isShared() const { return layers == 1; }
+    glm::ivec2 getEyeSize() const { return eyeSize; }
+    int getLevelCount() const { return levels; }
+    const glm::mat4& getViewProjection(EyeIndex eye) const { return viewProjections[eye]; }
+
+private:
+    struct LevelUniforms
+    {
+        Uniform<glm::ivec2> sourceSize, destinationSize;
+    };
+
+    std::unique_ptr<Shader> fromDepthProgram, reduceProgram;
+    LevelUniforms fromDepthUniforms, reduceUniforms;
+    Uniform<bool> mergeEyes;
+
+    unsigned int texture = 0;
+    glm::ivec2 eyeSize = glm::ivec2(0);
+    int levels = 0;
+    int layers = 0;
+    glm::mat4 viewProjections[2];
+
+    void allocate(glm::ivec2 size, int layerCount);
+};
+
+#endif
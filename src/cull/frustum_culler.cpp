@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <cfloat>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FRUSTUM_CULL_SSE 1
+#endif
+
+#include "frustum_culler.hpp"
+#include "../util/profiler.hpp"
+
+// Gribb and Hartmann: the planes of a view projection matrix are sums and differences of its rows
+static void extractPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+    glm::mat4 rows = glm::transpose(viewProjection);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        planes[axis * 2] = rows[3] + rows[axis];
+        planes[axis * 2 + 1] = rows[3] - rows[axis];
+    }
+    for (int i = 0; i < 6; i++)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+Frustum combinedStereoFrustum(const StereoCameraBlock& camera)
+{
+    glm::vec4 eyePlanes[2][6];
+    glm::vec3 corners[16];
+    for (int eye = 0; eye < 2; eye++)
+    {
+        glm::mat4 viewProjection = camera.projections[eye] * camera.views[eye];
+        extractPlanes(viewProjection, eyePlanes[eye]);
+
+        glm::mat4 inverse = glm::inverse(viewProjection);
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec4 ndc((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f, 1.0f);
+            glm::vec4 world = inverse * ndc;
+            corners[eye * 8 + corner] = glm::vec3(world) / world.w;
+        }
+    }
+
+    // Each eye's plane is pushed out until every corner of both frusta is inside it, and the one
+    // that moved least is kept. Usually one already holds the other eye's frustum: the off-axis
+    // frusta from get_frustum cross over, so the combined left plane is the right eye's.
+    Frustum frustum;
+    for (int i = 0; i < 6; i++)
+    {
+        float leastPush = FLT_MAX;
+        for (int eye = 0; eye < 2; eye++)
+        {
+            glm::vec3 normal = glm::vec3(eyePlanes[eye][i]);
+            float distance = eyePlanes[eye][i].w;
+            for (const glm::vec3& corner : corners)
+                distance = std::max(distance, -glm::dot(normal, corner));
+
+            if (distance - eyePlanes[eye][i].w < leastPush)
+            {
+                leastPush = distance - eyePlanes[eye][i].w;
+                frustum.planes[i] = glm::vec4(normal, distance);
+            }
+        }
+    }
+    return frustum;
+}
+
+void FrustumCuller::gatherSpheres(const FishSchool& school, const Model& model)
+{
+    glm::vec3 center = model.getBoundsCenter();
+    // The swim animation can carry vertices past the model's own bounds
+    float radius = model.getBoundsRadius() + FISH_SWIM_AMPLITUDE;
+
+    size_t count = school.instances.size();
+    size_t padded = (count + 3) & ~size_t(3);
+    centerX.assign(padded, 0.0f);
+    centerY.assign(padded, 0.0f);
+    centerZ.assign(padded, 0.0f);
+    // A negative radius fails every plane test, so the padding is never visible
+    radii.assign(padded, -FLT_MAX);
+    for (size_t i = 0; i < count; i++)
+    {
+        const glm::mat4& transform = school.instances[i].model;
+        glm::vec3 worldCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+        centerX[i] = worldCenter.x;
+        centerY[i] = worldCenter.y;
+        centerZ[i] = worldCenter.z;
+        radii[i] = radius * scale;
+    }
+
+    boundsInstances = school.instances.data();
+    boundsCount = count;
+    boundsSphere = glm::vec4(center, radius);
+}
+
+void FrustumCuller::keepAll(const FishSchool& school)
+{
+    visible.assign(school.instances.size(), 1);
+    counters.visible = school.count();
+    counters.culled = 0;
+}
+
+void FrustumCuller::cull(const FishSchool& school, const Model& model, const Frustum& frustum)
+{
+    PROFILE_ZONE("FrustumCuller::cull");
+    glm::vec4 sphere(model.getBoundsCenter(), model.getBoundsRadius() + FISH_SWIM_AMPLITUDE);
+    if (school.instances.data() != boundsInstances || school.instances.size() != boundsCount || sphere != boundsSphere)
+        gatherSpheres(school, model);
+
+    size_t count = boundsCount;
+    visible.resize(centerX.size());
+    counters.visible = 0;
+
+#ifdef FRUSTUM_CULL_SSE
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (int p = 0; p < 6; p++)
+    {
+        planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+    }
+
+    for (size_t i = 0; i < centerX.size(); i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&centerX[i]);
+        __m128 y = _mm_loadu_ps(&centerY[i]);
+        __m128 z = _mm_loadu_ps(&centerZ[i]);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radii[i]));
+
+        // Inside unless the centre is more than a radius behind some plane
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)), _mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; lane < 4; lane++)
+            visible[i + lane] = (mask >> lane) & 1;
+    }
+#else
+    for (size_t i = 0; i < centerX.size(); i++)
+    {
+        bool inside = true;
+        for (int p = 0; p < 6; p++)
+        {
+            const glm::vec4& plane = frustum.planes[p];
+            inside = inside && plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w >= -radii[i];
+        }
+        visible[i] = inside;
+    }
+#endif
+
+    visible.resize(count);
+    for (size_t i = 0; i < count; i++)
+        counters.visible += visible[i];
+    counters.culled = count - counters.visible;
+}
@@ -0,0 +1,61 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "../model/model.h"
+#include "../scene/scene_buffers.hpp"
+#include "../school/school.hpp"
+
+// Six planes as (normal, distance), normals pointing inwards: a point p is inside a plane
+// when dot(normal, p) + distance >= 0. Order: left, right, bottom, top, near, far.
+struct Frustum
+{
+    glm::vec4 planes[6];
+};
+
+// One frustum holding both eyes' views, so each fish is tested once rather than per eye.
+// Every plane is one of the eyes' own, moved out if need be until all sixteen corners of the
+// two frusta are inside it, so it is conservative for any pair of eyes.
+Frustum combinedStereoFrustum(const StereoCameraBlock& camera);
+
+struct CullStats
+{
+    unsigned int visible = 0;
+    unsigned int culled = 0;
+    // How many of the culled were inside a frustum but hidden in the depth pyramid
+    unsigned int occluded = 0;
+};
+
+// Tests the bounding sphere of every fish against a frustum, four at a time with SSE where
+// it is available. The spheres are gathered into flat arrays once per school and model, as
+// fish never move after the school is built; their swimming happens in the vertex shader.
+class FrustumCuller
+{
+public:
+    void cull(const FishSchool& school, const Model& model, const Frustum& frustum);
+    // Marks every fish visible, for comparing against culled runs
+    void keepAll(const FishSchool& school);
+
+    // Per fish, 1 when any part of its sphere may be in view
+    const std::vector<uint8_t>& visibility() const { return visible; }
+    const CullStats& stats() const { return counters; }
+
+private:
+    // Structure of arrays, padded to a multiple of four with spheres that are never visible
+    std::vector<float> centerX, centerY, centerZ, radii;
+    // What the arrays were built from
+    const FishInstance* boundsInstances = nullptr;
+    size_t boundsCount = 0;
+    glm::vec4 boundsSphere = glm::vec4(0.0f);
+
+    std::vector<uint8_t> visible;
+    CullStats counters;
+
+    void gatherSpheres(const FishSchool& school, const Model& model);
+};
+
+#endif
@@ -0,0 +1,174 @@
+#include <vector>
+
+#include "gpu_culler.hpp"
+#include "../model/mesh_simplifier.h"
+#include "../util/profiler.hpp"
+
+// local_size_x of both passes in shaders/cull.comp.glsl
+const unsigned int CULL_WORKGROUP_SIZE = 64;
+
+// occlusionMode in shaders/cull.comp.glsl
+const int CULL_OCCLUSION_OFF = 0;
+const int CULL_OCCLUSION_PER_EYE = 1;
+const int CULL_OCCLUSION_SHARED = 2;
+
+// The occluded count, then one count per level
+const size_t COUNTS_SIZE = (1 + MAX_LOD_LEVELS) * sizeof(unsigned int);
+
+GpuCuller::GpuCuller()
+{
+    glGenBuffers(1, &orderBuffer);
+    glGenBuffers(1, &levelsBuffer);
+    glGenBuffers(1, &countsBuffer);
+    glGenBuffers(1, &statsBuffer);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, countsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, COUNTS_SIZE, NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, statsBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, COUNTS_SIZE, NULL, GL_STREAM_READ);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+GpuCuller::~GpuCuller()
+{
+    glDeleteSync(statsFence);
+    glDeleteBuffers(1, &orderBuffer);
+    glDeleteBuffers(1, &levelsBuffer);
+    glDeleteBuffers(1, &countsBuffer);
+    glDeleteBuffers(1, &statsBuffer);
+    if (cullProgram)
+        glDeleteProgram(cullProgram->ID);
+    if (commandProgram)
+        glDeleteProgram(commandProgram->ID);
+}
+
+void GpuCuller::cull(const FishSchool& school, Model& model, glm::vec3 viewPosition, float pixelsPerUnit, const LodSettings& settings, unsigned int viewCount, const DepthPyramid* occluders)
+{
+    PROFILE_ZONE("GpuCuller::cull");
+    if (!cullProgram)
+    {
+        cullProgram.reset(new Shader(Shader::compute("shaders/cull.comp.glsl")));
+        commandProgram.reset(new Shader(Shader::compute("shaders/cull.comp.glsl", "#define WRITE_COMMANDS\n")));
+
+        cullUniforms.fishCount = cullProgram->uniform<int>("fishCount");
+        cullUniforms.lodCount = cullProgram->uniform<int>("lodCount");
+        cullUniforms.boundsSphere = cullProgram->uniform<glm::vec4>("boundsSphere");
+        cullUniforms.lodErrors = cullProgram->uniform<glm::vec4>("lodErrors");
+        cullUniforms.swimAmplitude = cullProgram->uniform<float>("swimAmplitude");
+        cullUniforms.pixelsPerUnit = cullProgram->uniform<float>("pixelsPerUnit");
+        cullUniforms.errorPixels = cullProgram->uniform<float>("errorPixels");
+        cullUniforms.hysteresis = cullProgram->uniform<float>("hysteresis");
+        cullUniforms.viewPosition = cullProgram->uniform<glm::vec3>("viewPosition");
+        cullUniforms.occlusionMode = cullProgram->uniform<int>("occlusionMode");
+        cullUniforms.pyramidLevels = cullProgram->uniform<int>("pyramidLevels");
+        cullUniforms.pyramidEyeSize = cullProgram->uniform<glm::ivec2>("pyramidEyeSize");
+        cullUniforms.pyramidViewProjections[0] = cullProgram->uniform<glm::mat4>("pyramidViewProjections[0]");
+        cullUniforms.pyramidViewProjections[1] = cullProgram->uniform<glm::mat4>("pyramidViewProjections[1]");
+        cullUniforms.boundsExtent = cullProgram->uniform<glm::vec3>("boundsExtent");
+        commandUniforms.fishCount = commandProgram->uniform<int>("fishCount");
+        commandUniforms.lodCount = commandProgram->uniform<int>("lodCount");
+        commandUniforms.meshCount = commandProgram->uniform<int>("meshCount");
+        commandUniforms.viewCount = commandProgram->uniform<int>("viewCount");
+    }
+
+    fishCount = school.count();
+    lodCount = model.getLodCount();
+    if (fishCount > fishCapacity)
+    {
+        // Every level gets room for the whole school, so each starts at a fixed baseInstance
+        fishCapacity = fishCount;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, orderBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, MAX_LOD_LEVELS * fishCapacity * sizeof(unsigned int), NULL, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, levelsBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, fishCapacity * sizeof(unsigned int), NULL, GL_DYNAMIC_COPY);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, countsBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    school.bind();
+    bind();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_LEVELS_BINDING, levelsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LEVEL_COUNTS_BINDING, countsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_COMMANDS_BINDING, model.getIndirectBuffer());
+
+    glm::vec4 lodErrors(0.0f);
+    for (unsigned int level = 0; level < lodCount && level < MAX_LOD_LEVELS; level++)
+        lodErrors[level] = model.getLodError(level);
+
+    cullProgram->use();
+    cullProgram->set(cullUniforms.fishCount, (int)fishCount);
+    cullProgram->set(cullUniforms.lodCount, (int)lodCount);
+    cullProgram->set(cullUniforms.boundsSphere, glm::vec4(model.getBoundsCenter(), model.getBoundsRadius()));
+    cullProgram->set(cullUniforms.swimAmplitude, FISH_SWIM_AMPLITUDE);
+    cullProgram->set(cullUniforms.viewPosition, viewPosition);
+    cullProgram->set(cullUniforms.pixelsPerUnit, pixelsPerUnit);
+    cullProgram->set(cullUniforms.errorPixels, settings.errorPixels);
+    cullProgram->set(cullUniforms.hysteresis, settings.hysteresis);
+    cullProgram->set(cullUniforms.lodErrors, lodErrors);
+    if (occluders && occluders->isBuilt())
+    {
+        occluders->bind();
+        cullProgram->set(cullUniforms.occlusionMode, occluders->isShared() ? CULL_OCCLUSION_SHARED : CULL_OCCLUSION_PER_EYE);
+        cullProgram->set(cullUniforms.pyramidLevels, occluders->getLevelCount());
+        cullProgram->set(cullUniforms.pyramidEyeSize, occluders->getEyeSize());
+        cullProgram->set(cullUniforms.pyramidViewProjections[0], occluders->getViewProjection(LEFT_EYE));
+        cullProgram->set(cullUniforms.pyramidViewProjections[1], occluders->getViewProjection(RIGHT_EYE));
+        cullProgram->set(cullUniforms.boundsExtent, model.getBoundsExtent());
+    }
+    else
+    {
+        cullProgram->set(cullUniforms.occlusionMode, CULL_OCCLUSION_OFF);
+    }
+    glDispatchCompute((fishCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    unsigned int commandCount = lodCount * model.getMeshCount();
+    commandProgram->use();
+    commandProgram->set(commandUniforms.fishCount, (int)fishCount);
+    commandProgram->set(commandUniforms.lodCount, (int)lodCount);
+    commandProgram->set(commandUniforms.meshCount, (int)model.getMeshCount());
+    commandProgram->set(commandUniforms.viewCount, (int)viewCount);
+    glDispatchCompute((commandCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+    // The draws source their commands from the buffer and the vertex shader reads the order;
+    // the stats copy below reads the counts the shaders wrote
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    if (!statsFence)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, countsBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, statsBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, COUNTS_SIZE);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        statsFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        statsFishCount = fishCount;
+    }
+}
+
+void GpuCuller::bind() const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_ORDER_BINDING, orderBuffer);
+}
+
+const CullStats& GpuCuller::stats()
+{
+    if (statsFence && glClientWaitSync(statsFence, 0, 0) != GL_TIMEOUT_EXPIRED)
+    {
+        unsigned int counts[1 + MAX_LOD_LEVELS];
+        glBindBuffer(GL_COPY_READ_BUFFER, statsBuffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, COUNTS_SIZE, counts);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteSync(statsFence);
+        statsFence = 0;
+
+        counters.occluded = counts[0];
+        counters.visible = 0;
+        for (unsigned int level = 0; level < MAX_LOD_LEVELS; level++)
+            counters.visible += counts[1 + level];
+        counters.culled = statsFishCount - counters.visible;
+    }
+    return counters;
+}
@@ -0,0 +1,77 @@
+#ifndef GPU_CULLER_H
+#define GPU_CULLER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <memory>
+
+#include "depth_pyramid.hpp"
+#include "frustum_culler.hpp"
+#include "../lod/lod_selector.hpp"
+#include "../model/model.h"
+#include "../school/school.hpp"
+#include "../shader/shader.hpp"
+
+// Storage bindings used by shaders/cull.comp.glsl next to the school (INSTANCE_BINDING) and
+// the instance order (INSTANCE_ORDER_BINDING)
+const unsigned int INSTANCE_LEVELS_BINDING = 2;
+const unsigned int LEVEL_COUNTS_BINDING = 3;
+const unsigned int DRAW_COMMANDS_BINDING = 4;
+
+// Frustum culling and level of detail selection for the whole school in two compute
+// dispatches: one tests every fish against both eyes and appends the visible ones to their
+// level's range of the instance order, the next writes the counts into the model's indirect
+// commands. The draw then reads them straight from the buffer, nothing waits on a readback.
+// The model has to be ready, its level count and commands are needed up front.
+// Given a built depth pyramid the first dispatch also drops fish hidden behind what was drawn
+// the frame before. That frame is all it knows about, so a fish coming out from behind
+// something shows up a frame late.
+class GpuCuller
+{
+public:
+    GpuCuller();
+    ~GpuCuller();
+    GpuCuller(const GpuCuller&) = delete;
+    GpuCuller& operator=(const GpuCuller&) = delete;
+
+    // Reads the eyes from the StereoCamera block, so run it after SceneBuffers::updateCamera.
+    // occluders may be null, or not built yet, for frustum culling alone.
+    void cull(const FishSchool& school, Model& model, glm::vec3 viewPosition, float pixelsPerUnit, const LodSettings& settings, unsigned int viewCount, const DepthPyramid* occluders = nullptr);
+    // Binds the instance order for the vertex shader
+    void bind() const;
+
+    // From a frame or two back: the counts are copied aside and read once the GPU is done with
+    // them, so the stats never stall a frame
+    const CullStats& stats();
+
+private:
+    struct CullUniforms
+    {
+        Uniform<int> fishCount, lodCount, occlusionMode, pyramidLevels;
+        Uniform<glm::vec4> boundsSphere, lodErrors;
+        Uniform<float> swimAmplitude, pixelsPerUnit, errorPixels, hysteresis;
+        Uniform<glm::vec3> viewPosition, boundsExtent;
+        Uniform<glm::ivec2> pyramidEyeSize;
+        Uniform<glm::mat4> pyramidViewProjections[2];
+    };
+    struct CommandUniforms
+    {
+        Uniform<int> fishCount, lodCount, meshCount, viewCount;
+    };
+
+    // Built on first use, so runs culling on the CPU never compile them
+    std::unique_ptr<Shader> cullProgram, commandProgram;
+    CullUniforms cullUniforms;
+    CommandUniforms commandUniforms;
+    unsigned int orderBuffer, levelsBuffer, countsBuffer, statsBuffer;
+    size_t fishCapacity = 0;
+    unsigned int fishCount = 0;
+    unsigned int lodCount = 0;
+
+    GLsync statsFence = 0;
+    unsigned int statsFishCount = 0;
+    CullStats counters;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include <cstring>
+#include <iostream>
+
+#include "headless_context.hpp"
+
+#include <EGL/eglext.h>
+
+static EGLDisplay openDisplay()
+{
+    const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (extensions && std::strstr(extensions, "EGL_MESA_platform_surfaceless"))
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay)
+        {
+            EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            if (display != EGL_NO_DISPLAY)
+                return display;
+        }
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+HeadlessContext::HeadlessContext() : display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT), surface(EGL_NO_SURFACE)
+{
+}
+
+HeadlessContext::~HeadlessContext()
+{
+    destroy();
+}
+
+bool HeadlessContext::create()
+{
+    display = openDisplay();
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+    {
+        std::cout << "ERROR::HEADLESS::NO_EGL_DISPLAY" << std::endl;
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        std::cout << "ERROR::HEADLESS::NO_DESKTOP_GL" << std::endl;
+        return false;
+    }
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+    {
+        std::cout << "ERROR::HEADLESS::NO_EGL_CONFIG" << std::endl;
+        return false;
+    }
+
+    // llvmpipe and older drivers stop at 4.5; the shaders are patched to match in that case
+    const int versions[][2] = { { 4, 6 }, { 4, 5 } };
+    for (const auto& version : versions)
+    {
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, version[0],
+            EGL_CONTEXT_MINOR_VERSION, version[1],
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+        if (context != EGL_NO_CONTEXT)
+        {
+            majorVersion = version[0];
+            minorVersion = version[1];
+            break;
+        }
+    }
+
+    if (context == EGL_NO_CONTEXT)
+    {
+        std::cout << "ERROR::HEADLESS::NO_GL_4_5_CONTEXT" << std::endl;
+        return false;
+    }
+
+    // Surfaceless where supported, otherwise a token pbuffer just to make the context current
+    const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (!extensions || !std::strstr(extensions, "EGL_KHR_surfaceless_context"))
+    {
+        const EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+    }
+
+    if (!eglMakeCurrent(display, surface, surface, context))
+    {
+        std::cout << "ERROR::HEADLESS::MAKE_CURRENT_FAILED" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void HeadlessContext::destroy()
+{
+    if (display == EGL_NO_DISPLAY)
+        return;
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (surface != EGL_NO_SURFACE)
+        eglDestroySurface(display, surface);
+    if (context != EGL_NO_CONTEXT)
+        eglDestroyContext(display, context);
+    eglTerminate(display);
+
+    display = EGL_NO_DISPLAY;
+    context = EGL_NO_CONTEXT;
+    surface = EGL_NO_SURFACE;
+}
+
+void* HeadlessContext::getProcAddress(const char* name)
+{
+    return (void*)eglGetProcAddress(name);
+}
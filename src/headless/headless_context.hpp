@@ -0,0 +1,33 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <EGL/egl.h>
+
+// OpenGL core context with no window or display server, for benchmarking and regression
+// runs on build machines. Uses EGL on the surfaceless platform where available (Mesa,
+// including llvmpipe), falling back to the default display with a 1x1 pbuffer.
+// All rendering goes to application framebuffers; there is no default framebuffer to show.
+class HeadlessContext
+{
+public:
+    int majorVersion = 0;
+    int minorVersion = 0;
+
+    HeadlessContext();
+    ~HeadlessContext();
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // Creates a 4.6 core context, or 4.5 if the driver stops there, and makes it current.
+    bool create();
+    void destroy();
+
+    static void* getProcAddress(const char* name);
+
+private:
+    EGLDisplay display;
+    EGLContext context;
+    EGLSurface surface;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <cmath>
+
+#include "lod_selector.hpp"
+#include "../util/profiler.hpp"
+
+// Keeps an instance with the camera inside its bounds from dividing by zero
+const float LOD_MIN_DISTANCE = 1e-3f;
+
+LodSelector::LodSelector()
+{
+    glGenBuffers(1, &SSBO);
+}
+
+LodSelector::~LodSelector()
+{
+    glDeleteBuffers(1, &SSBO);
+}
+
+void LodSelector::select(const FishSchool& school, const std::vector<uint8_t>& visible, const Model& model, glm::vec3 viewPosition, float pixelsPerUnit, const LodSettings& settings)
+{
+    PROFILE_ZONE("LodSelector::select");
+    unsigned int count = school.count();
+    unsigned int levelCount = model.getLodCount();
+    if (levels.size() != count)
+        levels.assign(count, 0);
+
+    // Coarsest level whose error, projected at pixelsPerObjectUnit, stays within limit. Errors
+    // grow with the level, so the first one over the limit ends the search.
+    auto coarsest = [&model, levelCount](float pixelsPerObjectUnit, float limit) {
+        unsigned int level = 0;
+        while (level + 1 < levelCount && model.getLodError(level + 1) * pixelsPerObjectUnit <= limit)
+            level++;
+        return level;
+    };
+
+    glm::vec3 center = model.getBoundsCenter();
+    float radius = model.getBoundsRadius();
+    std::vector<unsigned int> levelCounts(levelCount, 0);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        // A culled fish keeps its level for when it comes back into view
+        if (!visible[i])
+            continue;
+
+        const glm::mat4& transform = school.instances[i].model;
+        glm::vec3 worldCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+
+        // Measured to the nearest point of the bounding sphere, so a large model close by is
+        // judged by its near side
+        float distance = std::max(glm::length(worldCenter - viewPosition) - radius * scale, LOD_MIN_DISTANCE);
+        float pixelsPerObjectUnit = pixelsPerUnit * scale / distance;
+
+        // Only leave the current level once the error is clearly past the threshold either way
+        unsigned int finest = coarsest(pixelsPerObjectUnit, settings.errorPixels * (1.0f - settings.hysteresis));
+        unsigned int coarse = coarsest(pixelsPerObjectUnit, settings.errorPixels * (1.0f + settings.hysteresis));
+        unsigned int level = std::min(std::max((unsigned int)levels[i], finest), coarse);
+        levels[i] = level;
+        levelCounts[level]++;
+    }
+
+    // Counting sort by level, keeping school order within a level
+    levelBatches.resize(levelCount);
+    unsigned int first = 0;
+    for (unsigned int level = 0; level < levelCount; level++)
+    {
+        levelBatches[level].firstInstance = first;
+        levelBatches[level].instanceCount = levelCounts[level];
+        first += levelCounts[level];
+    }
+
+    order.resize(first);
+    std::fill(levelCounts.begin(), levelCounts.end(), 0);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (!visible[i])
+            continue;
+        unsigned int level = levels[i];
+        order[levelBatches[level].firstInstance + levelCounts[level]++] = i;
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO);
+    if (order.size() > capacity)
+    {
+        capacity = order.size();
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(unsigned int), NULL, GL_STREAM_DRAW);
+    }
+    if (!order.empty())
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, order.size() * sizeof(unsigned int), order.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void LodSelector::bind() const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_ORDER_BINDING, SSBO);
+}
@@ -0,0 +1,52 @@
+#ifndef LOD_SELECTOR_H
+#define LOD_SELECTOR_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "../model/model.h"
+#include "../school/school.hpp"
+
+// Shader storage binding of the instance order, declared in shaders/shader.vert.glsl
+const unsigned int INSTANCE_ORDER_BINDING = 1;
+
+struct LodSettings
+{
+    // Largest screen space error allowed, in pixels; 0 keeps every instance at full detail
+    float errorPixels;
+    // Fraction of errorPixels an instance has to move past a threshold before it switches level
+    float hysteresis;
+};
+
+// Picks a level of detail per instance from its projected size, once per frame for both eyes,
+// and groups the instances by level. The grouped order goes to a storage buffer that the vertex
+// shader reads at gl_BaseInstance + instance, so each level is one range of instances.
+class LodSelector
+{
+public:
+    LodSelector();
+    ~LodSelector();
+    LodSelector(const LodSelector&) = delete;
+    LodSelector& operator=(const LodSelector&) = delete;
+
+    // pixelsPerUnit is the eye height in pixels over the height the view spans one unit away.
+    // Fish whose visible entry is 0 are left out of every batch.
+    void select(const FishSchool& school, const std::vector<uint8_t>& visible, const Model& model, glm::vec3 viewPosition, float pixelsPerUnit, const LodSettings& settings);
+    void bind() const;
+
+    // One batch per level, in the order and counts of the last select, covering only the visible fish
+    const std::vector<LodBatch>& batches() const { return levelBatches; }
+
+private:
+    unsigned int SSBO;
+    size_t capacity = 0;
+    // Each instance's current level, kept between frames for the hysteresis
+    std::vector<uint8_t> levels;
+    std::vector<unsigned int> order;
+    std::vector<LodBatch> levelBatches;
+};
+
+#endif
@@ -9,62 +9,141 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "shader/shader.hpp"
+#include "bench/benchmark.hpp"
+#include "bench/camera_path.hpp"
+#include "bench/gpu_timer.hpp"
 #include "camera/camera.hpp"
+#include "cull/depth_pyramid.hpp"
+#include "cull/frustum_culler.hpp"
+#include "cull/gpu_culler.hpp"
+#include "headless/headless_context.hpp"
+#include "lod/lod_selector.hpp"
 #include "model/model.h"
+#include "options/options.hpp"
+#include "scene/scene_buffers.hpp"
+#include "school/school.hpp"
+#include "stereo/eye_target.hpp"
+#include "texture/texture_loader.hpp"
+#include "util/profiler.hpp"
+#include "util/thread_pool.hpp"
 #include <glm/trigonometric.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <iostream>
 #include <vector>
 
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
-const unsigned int FISH_COUNT = 1;
 const float CAMERA_OFFSET = 0.0325f;
 
+Options options;
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
+bool traceKeyDown = false;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 float lastFrame_fps = 0.0f;
 int frameCount = 0;
+int windowWidth = SCR_WIDTH * 2;
+int windowHeight = SCR_HEIGHT;
+std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
 
-void measure_frame_time(float currentFrame);
+// Uniform handles resolved once after the programs link, reused every frame. Camera,
+// time and light data live in the shared uniform blocks owned by SceneBuffers.
+struct SceneUniforms
+{
+    Uniform<int> layer;
+};
+
+// Which fish are drawn this frame and at what level of detail: picked on the CPU, or by the
+// culling compute pass once the model is ready for it, which can also test the depth the
+// frame before left in the pyramid
+struct FishSelection
+{
+    FrustumCuller culler;
+    LodSelector lods;
+    GpuCuller gpuCuller;
+    DepthPyramid depthPyramid;
+    bool onGpu = false;
+};
+
+void measure_frame_time(float currentFrame, std::vector<GpuFrameTimes>& gpuTimes, const CullStats& culling);
+void report_headless_timings(const std::vector<double>& frameTimes, const std::vector<GpuFrameTimes>& gpuTimes, const CullStats& culling);
+void print_gpu_pass_times(const std::vector<GpuFrameTimes>& gpuTimes);
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
-unsigned int loadCubemap(const std::vector<std::string>& faces);
-void render_scene(Shader& skyboxShader, unsigned int skyboxVAO, unsigned int skyboxTexture, Shader& shaderProgram, const glm::vec3 offsets[], Model& fishy, bool isLeftEye, glm::vec3 offset);
-glm::mat4 get_frustum(bool isLeftEye);
-void setupFramebuffer(unsigned int& fbo, unsigned int& texture, unsigned int& rbo);
+unsigned int loadCubemap(const std::string& ktxPath, const std::vector<std::string>& faces);
+void render_scene(Shader& skyboxShader, unsigned int skyboxVAO, unsigned int skyboxTexture, Shader& shaderProgram, const FishSchool& school, const FishSelection& selection, Model& fishy, const SceneBuffers& sceneBuffers, EyeIndex eye, GpuPassTimer& gpuTimer);
+void render_scene_single_pass(Shader& skyboxShader, unsigned int skyboxVAO, unsigned int skyboxTexture, Shader& shaderProgram, const FishSchool& school, const FishSelection& selection, Model& fishy, GpuPassTimer& gpuTimer);
+void render_eyes(Shader& skyboxShader, unsigned int skyboxVAO, unsigned int skyboxTexture, Shader& shaderProgram, const FishSchool& school, const FishSelection& selection, Model& fishy, const EyeTarget& eyes, const SceneBuffers& sceneBuffers, GpuPassTimer& gpuTimer);
+int run_scene(GLFWwindow* window);
+int run_benchmark(unsigned int skyboxVAO, unsigned int skyboxTexture, Model& fishy, SceneBuffers& sceneBuffers, GpuPassTimer& gpuTimer);
+glm::mat4 get_frustum(bool isLeftEye, float aspect_ratio);
+StereoCameraBlock get_stereo_camera(float aspectRatio);
+void update_visible_fish(FishSelection& selection, const FishSchool& school, Model& fishy, const StereoCameraBlock& stereoCamera, unsigned int eyeHeight);
+void update_occluders(FishSelection& selection, const EyeTarget& eyes, const StereoCameraBlock& stereoCamera);
+const CullStats& visible_fish_stats(FishSelection& selection);
+void draw_fish(Shader& shaderProgram, const FishSelection& selection, Model& fishy, unsigned int viewCount);
+bool supportsSinglePassStereo();
 void setupQuad(unsigned int& vao, unsigned int& vbo, const float* vertices, size_t size);
 void setupSkybox(unsigned int& vao, unsigned int& vbo, const float* vertices, size_t size);
 
-int main()
+int main(int argc, char** argv)
 {
-    // Initialize GLFW and create window
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_SAMPLES, 4);
-
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH * 2, SCR_HEIGHT, "stereo stuff", NULL, NULL);
-    if (window == NULL)
-    {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
+    if (!parseOptions(argc, argv, options))
         return -1;
+
+    // Recording from the first line so startup shows up in the trace
+    setProfilerThreadName("main");
+    setProfilerEnabled(!options.tracePath.empty());
+
+    // Benchmarks never present, so they always run on the offscreen context
+    if (options.benchmark)
+        options.headless = true;
+
+    GLFWwindow* window = NULL;
+    HeadlessContext headless;
+    GLADloadproc loader;
+
+    if (options.headless)
+    {
+        // Offscreen context only, the eyes are rendered but never composited to a window
+        if (!headless.create())
+            return -1;
+        std::cout << "Headless OpenGL " << headless.majorVersion << "." << headless.minorVersion << " core context" << std::endl;
+        loader = (GLADloadproc)HeadlessContext::getProcAddress;
     }
+    else
+    {
+        // Initialize GLFW and create window
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_SAMPLES, 4);
+
+        window = glfwCreateWindow(SCR_WIDTH * 2, SCR_HEIGHT, "stereo stuff", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
 
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        loader = (GLADloadproc)glfwGetProcAddress;
+    }
 
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    if (!gladLoadGLLoader(loader))
     {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
@@ -74,16 +153,34 @@ int main()
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LEQUAL);
     glEnable(GL_MULTISAMPLE);
-    glfwSwapInterval(0);
+    if (!options.headless)
+        glfwSwapInterval(0);
 
-    // Load shaders
-    Shader shaderProgram("shaders/shader.vert.glsl", "shaders/shader.frag.glsl");
-    Shader skyboxShader("shaders/skybox.vert.glsl", "shaders/skybox.frag.glsl");
-    Shader quadShader("shaders/quad.vert.glsl", "shaders/quad.frag.glsl");
+    if (options.stereoMode == STEREO_SINGLE_PASS && !supportsSinglePassStereo())
+    {
+        std::cout << "Single pass stereo needs vertex shader gl_Layer output, falling back to two pass" << std::endl;
+        options.stereoMode = STEREO_TWO_PASS;
+    }
+
+    // Every texture decoded from here on gets a CPU built mip chain, block compressed if the driver takes the format
+    setTextureCompression(chooseTextureCompression(options.textureCompression));
+    setMipFilter(options.mipFilter);
+
+    // Every GL object is owned inside run_scene, so all of them are deleted while the context is still current
+    int status = run_scene(window);
+    if (!options.headless)
+        glfwTerminate();
 
-    // Load model
+    if (!options.tracePath.empty())
+        writeChromeTrace(options.tracePath);
+    return status;
+}
+
+int run_scene(GLFWwindow* window)
+{
+    // Load model: imported on the worker pool while the rest starts up, uploaded a slice per frame
     stbi_set_flip_vertically_on_load(false);
-    Model fishy("./resources/fishy/fish.obj");
+    Model fishy("./resources/fishy/fish.obj", options.compactVertices ? VERTEX_FORMAT_COMPACT : VERTEX_FORMAT_FLOAT, false, MODEL_LOAD_ASYNC);
 
     // Setup skybox
     float skyboxVertices[] = {
@@ -130,10 +227,8 @@ int main()
     setupQuad(quadVAO_left, quadVBO_left, quadVertices_left, sizeof(quadVertices_left));
     setupQuad(quadVAO_right, quadVBO_right, quadVertices_right, sizeof(quadVertices_right));
 
-    // Setup framebuffers for left and right eye
-    unsigned int frame_left, frame_right, texture_left, texture_right, rbo_left, rbo_right;
-    setupFramebuffer(frame_left, texture_left, rbo_left);
-    setupFramebuffer(frame_right, texture_right, rbo_right);
+    // Camera, frame and light uniform blocks shared by every program
+    SceneBuffers sceneBuffers;
 
     // Load cubemap
     std::vector<std::string> faces = {
@@ -145,68 +240,227 @@ int main()
         "./resources/blue/back.png"
     };
 
-    unsigned int skyboxTexture = loadCubemap(faces);
-
-    // Fish positions
-    glm::vec3 offsets[FISH_COUNT] = { glm::vec3(1.0f, 1.0f, -7.0f) };
+    unsigned int skyboxTexture = loadCubemap("./resources/blue/skybox.ktx2", faces);
 
     // Set light properties
+    LightBlock light;
+    light.position = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    light.ambient = glm::vec4(0.5f, 0.5f, 0.5f, 0.0f);
+    light.diffuse = glm::vec4(0.8f, 0.8f, 0.8f, 0.0f);
+    light.specular = glm::vec4(0.5f, 0.5f, 0.5f, 0.0f);
+    sceneBuffers.setLight(light);
+
+    // Per pass GPU times, read back a few frames late so the loop never waits on them
+    GpuPassTimer gpuTimer;
+    gpuTimer.create();
+
+    // Timed runs (the benchmark and the headless frame report) measure the finished model, not
+    // the placeholder or the frames that stream it in
+    if (options.benchmark || options.headless)
+        fishy.finishLoading();
+    if (options.benchmark)
+        return run_benchmark(skyboxVAO, skyboxTexture, fishy, sceneBuffers, gpuTimer);
+
+    // Load shaders
+    std::string stereoDefines = options.stereoMode == STEREO_SINGLE_PASS ? "#define SINGLE_PASS_STEREO\n" : "";
+    std::string vertexFormatDefines = options.compactVertices ? "#define COMPACT_VERTICES\n" : "";
+    Shader shaderProgram("shaders/shader.vert.glsl", "shaders/shader.frag.glsl", stereoDefines + vertexFormatDefines);
+    Shader skyboxShader("shaders/skybox.vert.glsl", "shaders/skybox.frag.glsl", stereoDefines);
+    Shader quadShader("shaders/quad.vert.glsl", "shaders/quad.frag.glsl");
+
+    SceneUniforms uniforms;
+    uniforms.layer = quadShader.uniform<int>("layer");
+
+    // Setup layered render target for left and right eye
+    EyeTarget eyes(options.eyeResolution.width, options.eyeResolution.height);
+
+    // Per-instance fish transforms, and the level of detail each one draws
+    FishSchool school(options.fishCount);
+    FishSelection selection;
+    update_visible_fish(selection, school, fishy, get_stereo_camera((float)eyes.width / eyes.height), eyes.height);
+
     shaderProgram.use();
-    shaderProgram.setVec3("light.position", 0.0f, 0.0f, 0.0f);
-    shaderProgram.setVec3("light.ambient", 0.5f, 0.5f, 0.5f);
-    shaderProgram.setVec3("light.diffuse", 0.8f, 0.8f, 0.8f);
-    shaderProgram.setVec3("light.specular", 0.5f, 0.5f, 0.5f);
     shaderProgram.setFloat("material.shininess", 64);
 
-    while (!glfwWindowShouldClose(window))
+    if (options.warmUp)
     {
-        float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
-        measure_frame_time(currentFrame);
-        lastFrame = currentFrame;
+        // Prime each program against the target it will draw into, with textures and buffers bound
+        auto warmStart = std::chrono::steady_clock::now();
+        if (options.stereoMode == STEREO_SINGLE_PASS)
+            eyes.bindLayered();
+        else
+            eyes.bindEye(LEFT_EYE);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
+        school.bind();
+        selection.lods.bind();
+        skyboxShader.warmUp();
+        shaderProgram.warmUp();
+
+        if (!options.headless)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, windowWidth, windowHeight);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, eyes.colorTexture);
+            quadShader.warmUp();
+        }
+        glFinish();
 
-        processInput(window);
+        double warmMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - warmStart).count();
+        std::cout << "Warmed up shader programs in " << warmMs << " ms" << std::endl;
+    }
 
-        // Render to left framebuffer
-        glBindFramebuffer(GL_FRAMEBUFFER, frame_left);
-        render_scene(skyboxShader, skyboxVAO, skyboxTexture, shaderProgram, offsets, fishy, true, glm::vec3(-CAMERA_OFFSET, 0.0f, 0.0f));
+    CameraRecorder cameraRecorder;
+    if (!options.recordCameraPath.empty() && !cameraRecorder.open(options.recordCameraPath))
+        return -1;
 
-        // Render to right framebuffer
-        glBindFramebuffer(GL_FRAMEBUFFER, frame_right);
-        render_scene(skyboxShader, skyboxVAO, skyboxTexture, shaderProgram, offsets, fishy, false, glm::vec3(CAMERA_OFFSET, 0.0f, 0.0f));
+    std::vector<double> headlessFrameTimes;
+    headlessFrameTimes.reserve(options.headless ? options.frames : 0);
+    std::vector<GpuFrameTimes> recentGpuTimes, headlessGpuTimes;
+    // Summed over every frame, for the mean in the headless report
+    CullStats headlessCulling;
 
-        // Render quads to screen
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClear(GL_COLOR_BUFFER_BIT);
+    while (options.headless ? headlessFrameTimes.size() < options.frames : !glfwWindowShouldClose(window))
+    {
+        PROFILE_ZONE("frame");
+        auto frameStart = std::chrono::steady_clock::now();
+        float currentFrame = std::chrono::duration<float>(frameStart - startTime).count();
+        deltaTime = currentFrame - lastFrame;
+        gpuTimer.beginFrame();
+        std::vector<GpuFrameTimes> finishedGpuFrames = gpuTimer.takeResults();
+        recentGpuTimes.insert(recentGpuTimes.end(), finishedGpuFrames.begin(), finishedGpuFrames.end());
+        if (options.headless)
+            headlessGpuTimes.insert(headlessGpuTimes.end(), finishedGpuFrames.begin(), finishedGpuFrames.end());
+        measure_frame_time(currentFrame, recentGpuTimes, visible_fish_stats(selection));
+        lastFrame = currentFrame;
 
-        quadShader.use();
-        glBindVertexArray(quadVAO_left);
-        glBindTexture(GL_TEXTURE_2D, texture_left);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        if (!options.headless)
+            processInput(window);
+        cameraRecorder.record(currentFrame, camera);
+
+        // Until it is ready the model draws a placeholder, so streaming never holds up a frame
+        fishy.continueLoading(options.streamBudgetMs);
+
+        // Written once per frame, read by both eyes and every program
+        StereoCameraBlock stereoCamera = get_stereo_camera((float)eyes.width / eyes.height);
+        sceneBuffers.updateCamera(stereoCamera);
+        sceneBuffers.updateFrame(currentFrame);
+        update_visible_fish(selection, school, fishy, stereoCamera, eyes.height);
+        // Read once: with GPU culling every call may pick up a newer readback
+        CullStats frameCulling = visible_fish_stats(selection);
+        headlessCulling.visible += frameCulling.visible;
+        headlessCulling.culled += frameCulling.culled;
+        headlessCulling.occluded += frameCulling.occluded;
+
+        render_eyes(skyboxShader, skyboxVAO, skyboxTexture, shaderProgram, school, selection, fishy, eyes, sceneBuffers, gpuTimer);
+        update_occluders(selection, eyes, stereoCamera);
+
+        if (options.headless)
+        {
+            // Nothing to present, so wait for the GPU to make the frame time include the rendering
+            gpuTimer.endFrame();
+            glFinish();
+            headlessFrameTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+            continue;
+        }
 
-        glBindVertexArray(quadVAO_right);
-        glBindTexture(GL_TEXTURE_2D, texture_right);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        // Render quads to screen
+        {
+            PROFILE_ZONE("composite");
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, windowWidth, windowHeight);
+            gpuTimer.begin(GPU_PASS_COMPOSITE);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            quadShader.use();
+            glBindTexture(GL_TEXTURE_2D_ARRAY, eyes.colorTexture);
+
+            glBindVertexArray(quadVAO_left);
+            quadShader.set(uniforms.layer, LEFT_EYE);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+
+            glBindVertexArray(quadVAO_right);
+            quadShader.set(uniforms.layer, RIGHT_EYE);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            gpuTimer.end(GPU_PASS_COMPOSITE);
+            gpuTimer.endFrame();
+        }
 
-        glfwSwapBuffers(window);
+        {
+            PROFILE_ZONE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
     }
 
-    glfwTerminate();
+    if (options.headless) {
+        gpuTimer.finish();
+        std::vector<GpuFrameTimes> finishedGpuFrames = gpuTimer.takeResults();
+        headlessGpuTimes.insert(headlessGpuTimes.end(), finishedGpuFrames.begin(), finishedGpuFrames.end());
+        report_headless_timings(headlessFrameTimes, headlessGpuTimes, headlessCulling);
+    }
+
     return 0;
 }
 
 // Function definitions
-void measure_frame_time(float currentFrame) {
+void measure_frame_time(float currentFrame, std::vector<GpuFrameTimes>& gpuTimes, const CullStats& culling) {
     frameCount++;
     if (currentFrame - lastFrame_fps >= 1.0f) {
         std::cout << "FrameTime: " << ((currentFrame - lastFrame_fps) / double(frameCount)) * 1000.0f << std::endl;
+        std::cout << "Fish: " << culling.visible << " visible, " << culling.culled << " culled (" << culling.occluded << " occluded)" << std::endl;
+        print_gpu_pass_times(gpuTimes);
+        gpuTimes.clear();
         frameCount = 0;
         lastFrame_fps = currentFrame;
     }
 }
 
+void report_headless_timings(const std::vector<double>& frameTimes, const std::vector<GpuFrameTimes>& gpuTimes, const CullStats& culling) {
+    if (frameTimes.empty())
+        return;
+
+    double total = 0.0;
+    for (double ms : frameTimes)
+        total += ms;
+    double mean = total / frameTimes.size();
+
+    std::cout << "Headless: " << frameTimes.size() << " frames, " << options.eyeResolution.width << "x" << options.eyeResolution.height << " per eye, "
+              << (options.stereoMode == STEREO_SINGLE_PASS ? "single-pass" : "two-pass") << ", " << options.fishCount << " fish" << std::endl;
+    std::cout << "Frame time: mean " << mean << " ms, min " << *std::min_element(frameTimes.begin(), frameTimes.end())
+              << " ms, max " << *std::max_element(frameTimes.begin(), frameTimes.end()) << " ms (" << 1000.0 / mean << " fps)" << std::endl;
+    std::cout << "Fish per frame: mean " << (double)culling.visible / frameTimes.size() << " visible, "
+              << (double)culling.culled / frameTimes.size() << " culled (" << (double)culling.occluded / frameTimes.size() << " occluded)" << std::endl;
+    print_gpu_pass_times(gpuTimes);
+}
+
+void print_gpu_pass_times(const std::vector<GpuFrameTimes>& gpuTimes) {
+    if (gpuTimes.empty())
+        return;
+
+    // Mean over the frames each pass actually ran in
+    double total = 0.0;
+    double passTotals[GPU_PASS_COUNT] = {};
+    unsigned int passFrames[GPU_PASS_COUNT] = {};
+    for (const GpuFrameTimes& times : gpuTimes) {
+        total += times.totalMs;
+        for (int pass = 0; pass < GPU_PASS_COUNT; pass++) {
+            if (times.passUsed[pass]) {
+                passTotals[pass] += times.passMs[pass];
+                passFrames[pass]++;
+            }
+        }
+    }
+
+    std::cout << "GpuTime: " << total / gpuTimes.size() << " ms";
+    for (int pass = 0; pass < GPU_PASS_COUNT; pass++)
+        if (passFrames[pass] > 0)
+            std::cout << ", " << gpuPassName((GpuPass)pass) << " " << passTotals[pass] / passFrames[pass] << " ms";
+    std::cout << std::endl;
+}
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
+    windowWidth = width;
+    windowHeight = height;
     glViewport(0, 0, width, height);
 }
 
@@ -234,9 +488,19 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
 }
 
 void processInput(GLFWwindow *window) {
+    PROFILE_ZONE("processInput");
+
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
+    // P pauses and resumes the trace, on the press rather than every frame it is held
+    bool traceKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (traceKey && !traceKeyDown && !options.tracePath.empty()) {
+        setProfilerEnabled(!profilerEnabled());
+        std::cout << "Profiler " << (profilerEnabled() ? "recording" : "paused") << std::endl;
+    }
+    traceKeyDown = traceKey;
+
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.ProcessKeyboard(FORWARD, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
@@ -247,64 +511,200 @@ void processInput(GLFWwindow *window) {
         camera.ProcessKeyboard(RIGHT, deltaTime);
 }
 
-unsigned int loadCubemap(const std::vector<std::string>& faces) {
+unsigned int loadCubemap(const std::string& ktxPath, const std::vector<std::string>& faces) {
+    PROFILE_ZONE("loadCubemap");
+    auto start = std::chrono::steady_clock::now();
+
     unsigned int textureID;
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++) {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data) {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        } else {
-            std::cout << "Cubemap tex failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
+    // A converted KTX2 cubemap (make ktx) uploads straight from the file; otherwise decode
+    // every face on the worker pool and upload each on this thread as it arrives
+    if (!uploadKtx2Cubemap(ktxPath)) {
+        std::vector<std::future<DecodedImage>> decodes;
+        for (unsigned int i = 0; i < faces.size(); i++)
+            decodes.push_back(decodeImageAsync(faces[i], TEXTURE_CONTENT_COLOR));
+
+        // The first face that loads sizes the immutable storage, every face then fills its full mip chain
+        bool allocated = false;
+        for (unsigned int i = 0; i < decodes.size(); i++) {
+            DecodedImage image = decodes[i].get();
+            if (!allocated)
+                allocated = allocateCubemapStorage(image);
+            uploadCubemapFace(i, image);
         }
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    // Minified heavily at typical eye resolutions, so it is sampled from the mips
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
+    double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Loaded cubemap in " << totalMs << " ms on " << workerPool().size() << " workers" << std::endl;
+
     return textureID;
 }
 
-void render_scene(Shader& skyboxShader, unsigned int skyboxVAO, unsigned int skyboxTexture, Shader& shaderProgram, const glm::vec3 offsets[], Model& fishy, bool isLeftEye, glm::vec3 offset) {
+void render_eyes(Shader& skyboxShader, unsigned int skyboxVAO, unsigned int skyboxTexture, Shader& shaderProgram, const FishSchool& school, const FishSelection& selection, Model& fishy, const EyeTarget& eyes, const SceneBuffers& sceneBuffers, GpuPassTimer& gpuTimer) {
+    if (options.stereoMode == STEREO_SINGLE_PASS)
+    {
+        // Render both eyes into their layers at once
+        eyes.bindLayered();
+        gpuTimer.begin(GPU_PASS_BOTH_EYES);
+        render_scene_single_pass(skyboxShader, skyboxVAO, skyboxTexture, shaderProgram, school, selection, fishy, gpuTimer);
+        gpuTimer.end(GPU_PASS_BOTH_EYES);
+    }
+    else
+    {
+        // Render to left eye layer
+        eyes.bindEye(LEFT_EYE);
+        gpuTimer.begin(GPU_PASS_LEFT_EYE);
+        render_scene(skyboxShader, skyboxVAO, skyboxTexture, shaderProgram, school, selection, fishy, sceneBuffers, LEFT_EYE, gpuTimer);
+        gpuTimer.end(GPU_PASS_LEFT_EYE);
+
+        // Render to right eye layer
+        eyes.bindEye(RIGHT_EYE);
+        gpuTimer.begin(GPU_PASS_RIGHT_EYE);
+        render_scene(skyboxShader, skyboxVAO, skyboxTexture, shaderProgram, school, selection, fishy, sceneBuffers, RIGHT_EYE, gpuTimer);
+        gpuTimer.end(GPU_PASS_RIGHT_EYE);
+    }
+}
+
+void render_scene(Shader& skyboxShader, unsigned int skyboxVAO, unsigned int skyboxTexture, Shader& shaderProgram, const FishSchool& school, const FishSelection& selection, Model& fishy, const SceneBuffers& sceneBuffers, EyeIndex eye, GpuPassTimer& gpuTimer) {
+    PROFILE_ZONE("render_scene");
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glm::mat4 projection = get_frustum(isLeftEye);
-    glm::mat4 view = glm::mat4(glm::mat3(camera.GetViewMatrix(glm::vec3(0.0f))));
+    // The shaders read this eye's camera from the shared block
+    sceneBuffers.bindEye(eye);
 
+    gpuTimer.begin(GPU_PASS_SKYBOX);
     glDepthMask(GL_FALSE);
     skyboxShader.use();
-    skyboxShader.setMat4("view", view);
-    skyboxShader.setMat4("projection", projection);
-
     glBindVertexArray(skyboxVAO);
     glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
     glDrawArrays(GL_TRIANGLES, 0, 36);
     glDepthMask(GL_TRUE);
+    gpuTimer.end(GPU_PASS_SKYBOX);
 
+    gpuTimer.begin(GPU_PASS_FISH);
     shaderProgram.use();
-    view = camera.GetViewMatrix(offset);
-    shaderProgram.setMat4("view", view);
-    shaderProgram.setMat4("projection", projection);
-    shaderProgram.setFloat("_Time", glfwGetTime());
-
-    for (int i = 0; i < FISH_COUNT; i++) {
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, offsets[i]);
-        shaderProgram.setMat4("model", model);
-        fishy.Draw(shaderProgram);
+    school.bind();
+    draw_fish(shaderProgram, selection, fishy, 1);
+    gpuTimer.end(GPU_PASS_FISH);
+}
+
+void render_scene_single_pass(Shader& skyboxShader, unsigned int skyboxVAO, unsigned int skyboxTexture, Shader& shaderProgram, const FishSchool& school, const FishSelection& selection, Model& fishy, GpuPassTimer& gpuTimer) {
+    PROFILE_ZONE("render_scene_single_pass");
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // One instance per eye, the vertex shader routes each to its layer
+    gpuTimer.begin(GPU_PASS_SKYBOX);
+    glDepthMask(GL_FALSE);
+    skyboxShader.use();
+    glBindVertexArray(skyboxVAO);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, 2);
+    glDepthMask(GL_TRUE);
+    gpuTimer.end(GPU_PASS_SKYBOX);
+
+    gpuTimer.begin(GPU_PASS_FISH);
+    shaderProgram.use();
+    school.bind();
+    draw_fish(shaderProgram, selection, fishy, 2);
+    gpuTimer.end(GPU_PASS_FISH);
+}
+
+int run_benchmark(unsigned int skyboxVAO, unsigned int skyboxTexture, Model& fishy, SceneBuffers& sceneBuffers, GpuPassTimer& gpuTimer) {
+    CameraPath path = CameraPath::scripted();
+    if (!options.cameraPath.empty() && !path.load(options.cameraPath))
+        return -1;
+
+    BenchmarkReport report;
+    report.renderer = (const char*)glGetString(GL_RENDERER);
+    report.version = (const char*)glGetString(GL_VERSION);
+    report.cameraPath = path.name;
+    report.frames = options.frames;
+    report.warmupFrames = BENCHMARK_WARMUP_FRAMES;
+
+    bool singlePassSupported = supportsSinglePassStereo();
+    unsigned int totalFrames = BENCHMARK_WARMUP_FRAMES + options.frames;
+
+    for (const BenchmarkConfig& config : benchmarkSweep(options)) {
+        if (config.stereoMode == STEREO_SINGLE_PASS && !singlePassSupported) {
+            std::cout << "Skipping single-pass runs, vertex shader gl_Layer output is not supported" << std::endl;
+            continue;
+        }
+
+        // Everything that depends on the configuration is rebuilt, the model and skybox are shared
+        options.stereoMode = config.stereoMode;
+        std::string stereoDefines = options.stereoMode == STEREO_SINGLE_PASS ? "#define SINGLE_PASS_STEREO\n" : "";
+        std::string vertexFormatDefines = options.compactVertices ? "#define COMPACT_VERTICES\n" : "";
+        Shader shaderProgram("shaders/shader.vert.glsl", "shaders/shader.frag.glsl", stereoDefines + vertexFormatDefines);
+        Shader skyboxShader("shaders/skybox.vert.glsl", "shaders/skybox.frag.glsl", stereoDefines);
+        shaderProgram.use();
+        shaderProgram.setFloat("material.shininess", 64);
+
+        EyeTarget eyes(config.eyeWidth, config.eyeHeight);
+        FishSchool school(config.fishCount);
+        FishSelection selection;
+
+        std::vector<double> cpuTimes;
+        for (unsigned int frame = 0; frame < totalFrames; frame++) {
+            auto frameStart = std::chrono::steady_clock::now();
+
+            // Poses and animation follow the frame index, not the clock, so runs stay comparable
+            path.apply(path.duration() * frame / (totalFrames - 1), camera);
+            StereoCameraBlock stereoCamera = get_stereo_camera((float)eyes.width / eyes.height);
+            sceneBuffers.updateCamera(stereoCamera);
+            sceneBuffers.updateFrame(frame * BENCHMARK_TIME_STEP);
+            update_visible_fish(selection, school, fishy, stereoCamera, eyes.height);
+
+            gpuTimer.beginFrame();
+            render_eyes(skyboxShader, skyboxVAO, skyboxTexture, shaderProgram, school, selection, fishy, eyes, sceneBuffers, gpuTimer);
+            update_occluders(selection, eyes, stereoCamera);
+            gpuTimer.endFrame();
+            // CPU time ends with the last submission; glFinish only keeps frames from overlapping
+            // on the GPU, and the time waiting in it belongs to the GPU figures
+            double cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+            glFinish();
+
+            if (frame + 1 == BENCHMARK_WARMUP_FRAMES) {
+                // Drop the warm-up frames' GPU times, the ring still holds some of them
+                gpuTimer.finish();
+                gpuTimer.takeResults();
+            }
+            if (frame < BENCHMARK_WARMUP_FRAMES)
+                continue;
+
+            cpuTimes.push_back(cpuMs);
+        }
+        gpuTimer.finish();
+
+        glDeleteProgram(shaderProgram.ID);
+        glDeleteProgram(skyboxShader.ID);
+
+        BenchmarkResult result;
+        result.config = config;
+        result.frames = options.frames;
+        result.cpu = computeFrameStats(cpuTimes);
+        setGpuFrameStats(result, gpuTimer.takeResults());
+        printBenchmarkResult(result);
+        report.results.push_back(result);
     }
+
+    bool written = true;
+    if (!options.benchJson.empty())
+        written = writeBenchmarkJson(options.benchJson, report) && written;
+    if (!options.benchCsv.empty())
+        written = writeBenchmarkCsv(options.benchCsv, report) && written;
+    return written ? 0 : -1;
 }
 
-glm::mat4 get_frustum(bool isLeftEye) {
+glm::mat4 get_frustum(bool isLeftEye, float aspect_ratio) {
     float fov = glm::radians(camera.Zoom);
-    float aspect_ratio = (float)SCR_WIDTH/(float)SCR_HEIGHT;
     float near = 0.5f;
     float far = 100.0f;
 
@@ -322,25 +722,67 @@ glm::mat4 get_frustum(bool isLeftEye) {
     return glm::frustum(left, right, -top, top, near, far);
 }
 
-void setupFramebuffer(unsigned int& fbo, unsigned int& texture, unsigned int& rbo) {
-    glGenFramebuffers(1, &fbo);
-    glGenTextures(1, &texture);
-    glGenRenderbuffers(1, &rbo);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
-
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+StereoCameraBlock get_stereo_camera(float aspectRatio) {
+    StereoCameraBlock stereoCamera;
+    glm::vec3 offsets[2] = { glm::vec3(-CAMERA_OFFSET, 0.0f, 0.0f), glm::vec3(CAMERA_OFFSET, 0.0f, 0.0f) };
+    for (int eye = 0; eye < 2; eye++) {
+        stereoCamera.projections[eye] = get_frustum(eye == LEFT_EYE, aspectRatio);
+        stereoCamera.views[eye] = camera.GetViewMatrix(offsets[eye]);
+        stereoCamera.skyViews[eye] = glm::mat4(glm::mat3(camera.GetViewMatrix(glm::vec3(0.0f))));
+    }
+    return stereoCamera;
+}
+
+// Once per frame for both eyes: culls against both eyes' frusta, then picks levels of detail
+// from the centre of the two eyes, so both draw every fish at the same level
+void update_visible_fish(FishSelection& selection, const FishSchool& school, Model& fishy, const StereoCameraBlock& stereoCamera, unsigned int eyeHeight) {
+    float pixelsPerUnit = eyeHeight / (2.0f * tan(glm::radians(camera.Zoom) / 2.0f));
+    LodSettings settings = { options.lodErrorPixels, options.lodHysteresis };
+
+    // The compute pass writes the model's draw commands, so it waits until they exist
+    selection.onGpu = options.culling == CULLING_GPU && fishy.isReady();
+    if (selection.onGpu) {
+        unsigned int viewCount = options.stereoMode == STEREO_SINGLE_PASS ? 2 : 1;
+        selection.gpuCuller.cull(school, fishy, camera.Position, pixelsPerUnit, settings, viewCount, options.occlusion != OCCLUSION_OFF ? &selection.depthPyramid : nullptr);
+        return;
+    }
+
+    if (options.culling == CULLING_NONE)
+        selection.culler.keepAll(school);
+    else
+        selection.culler.cull(school, fishy, combinedStereoFrustum(stereoCamera));
+    selection.lods.select(school, selection.culler.visibility(), fishy, camera.Position, pixelsPerUnit, settings);
+}
+
+// After both eyes are drawn: reduces their depth into the pyramid next frame's cull tests
+void update_occluders(FishSelection& selection, const EyeTarget& eyes, const StereoCameraBlock& stereoCamera) {
+    if (selection.onGpu && options.occlusion != OCCLUSION_OFF)
+        selection.depthPyramid.build(eyes, stereoCamera, options.occlusion == OCCLUSION_SHARED);
+}
+
+const CullStats& visible_fish_stats(FishSelection& selection) {
+    return selection.onGpu ? selection.gpuCuller.stats() : selection.culler.stats();
+}
+
+void draw_fish(Shader& shaderProgram, const FishSelection& selection, Model& fishy, unsigned int viewCount) {
+    if (selection.onGpu) {
+        selection.gpuCuller.bind();
+        fishy.DrawGenerated(shaderProgram);
+    } else {
+        selection.lods.bind();
+        fishy.Draw(shaderProgram, selection.lods.batches(), viewCount);
+    }
+}
+
+bool supportsSinglePassStereo() {
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int i = 0; i < count; i++) {
+        const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (std::strcmp(name, "GL_ARB_shader_viewport_layer_array") == 0 || std::strcmp(name, "GL_AMD_vertex_shader_layer") == 0)
+            return true;
+    }
+    return false;
 }
 
 void setupQuad(unsigned int& vao, unsigned int& vbo, const float* vertices, size_t size) {
@@ -1,27 +1,35 @@
 #include "mesh.h"
+#include "../util/profiler.hpp"
 
-Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/packing.hpp>
+
+size_t vertexStride(VertexFormat format)
 {
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
+    return format == VERTEX_FORMAT_COMPACT ? sizeof(CompactVertex) : sizeof(Vertex);
+}
 
-    setupMesh();
+size_t indexSize(GLenum indexType)
+{
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
 }
 
-void Mesh::setupMesh()
+void setupVertexAttributes(VertexFormat format)
 {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-  
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    if(format == VERTEX_FORMAT_COMPACT)
+    {
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Position));
 
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, Normal));
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, TexCoords));
+        return;
+    }
 
     glEnableVertexAttribArray(0);	
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
@@ -31,33 +39,251 @@ void Mesh::setupMesh()
 
     glEnableVertexAttribArray(2);	
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+}
 
-    glBindVertexArray(0);
+// Folds the lower hemisphere over the diagonals so the whole sphere maps onto [-1, 1]^2
+static glm::vec2 octahedralEncode(glm::vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    glm::vec2 p(n.x, n.y);
+    if(n.z < 0.0f)
+    {
+        p.x = (1.0f - abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+        p.y = (1.0f - abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return p;
+}
+
+static uint32_t packSnorm10(float value)
+{
+    int quantized = (int)round(glm::clamp(value, -1.0f, 1.0f) * 511.0f);
+    return (uint32_t)quantized & 0x3FF;
+}
+
+static vector<CompactVertex> packCompactVertices(const Vertex *vertexData, size_t vertexCount, glm::vec3 &offset, glm::vec3 &scale)
+{
+    glm::vec3 minimum(0.0f), maximum(0.0f);
+    if(vertexCount > 0)
+        minimum = maximum = vertexData[0].Position;
+    for(size_t i = 1; i < vertexCount; i++)
+    {
+        minimum = glm::min(minimum, vertexData[i].Position);
+        maximum = glm::max(maximum, vertexData[i].Position);
+    }
+
+    // Flat axes keep a nonzero scale so they still decode to the plane they lie in
+    offset = minimum;
+    scale = glm::max(maximum - minimum, glm::vec3(1e-6f));
+
+    vector<CompactVertex> packed(vertexCount);
+    for(size_t i = 0; i < vertexCount; i++)
+    {
+        const Vertex &vertex = vertexData[i];
+        glm::vec3 unorm = (vertex.Position - offset) / scale;
+        for(int axis = 0; axis < 3; axis++)
+            packed[i].Position[axis] = (uint16_t)round(glm::clamp(unorm[axis], 0.0f, 1.0f) * 65535.0f);
+        packed[i].Position[3] = 0;
+
+        glm::vec2 octahedral = octahedralEncode(vertex.Normal);
+        packed[i].Normal = packSnorm10(octahedral.x) | packSnorm10(octahedral.y) << 10;
+
+        packed[i].TexCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+        packed[i].TexCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
+    }
+    return packed;
+}
+
+Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexFormat format, vector<MeshLod> lods)
+    : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), lods(std::move(lods)), vertexFormat(format)
+{
+    setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size());
+}
+
+Mesh::Mesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount, vector<Texture> textures, VertexFormat format, vector<MeshLod> lods)
+    : textures(std::move(textures)), lods(std::move(lods)), vertexFormat(format)
+{
+    setupMesh(vertexData, vertexCount, indexData, indexCount);
+}
+
+Mesh::~Mesh()
+{
+    deleteBuffers();
+}
+
+Mesh::Mesh(Mesh &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+Mesh& Mesh::operator=(Mesh &&other) noexcept
+{
+    if(this == &other)
+        return *this;
+
+    deleteBuffers();
+    vertices = std::move(other.vertices);
+    indices = std::move(other.indices);
+    textures = std::move(other.textures);
+    VAO = other.VAO;
+    VBO = other.VBO;
+    EBO = other.EBO;
+    ownsVertexArray = other.ownsVertexArray;
+    vertexCount = other.vertexCount;
+    indexCount = other.indexCount;
+    lods = std::move(other.lods);
+    baseVertex = other.baseVertex;
+    firstIndex = other.firstIndex;
+    vertexFormat = other.vertexFormat;
+    indexType = other.indexType;
+    positionOffset = other.positionOffset;
+    positionScale = other.positionScale;
+    for(unsigned int slot = 0; slot < MATERIAL_SLOT_COUNT; slot++)
+        materialTextures[slot] = other.materialTextures[slot];
+
+    // The moved-from mesh keeps nothing to delete
+    other.VAO = other.VBO = other.EBO = 0;
+    return *this;
+}
+
+void Mesh::deleteBuffers()
+{
+    if(ownsVertexArray && VAO)
+        glDeleteVertexArrays(1, &VAO);
+    if(VBO)
+        glDeleteBuffers(1, &VBO);
+    if(EBO)
+        glDeleteBuffers(1, &EBO);
+    VAO = VBO = EBO = 0;
+}
+
+void Mesh::releaseCpuData()
+{
+    // Swapping with empty vectors gives the memory back, clear() would keep the capacity
+    vector<Vertex>().swap(vertices);
+    vector<unsigned int>().swap(indices);
 }
 
-void Mesh::Draw(Shader &shader) 
+void Mesh::setupMesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount)
 {
-    unsigned int diffuseNr = 1;
-    unsigned int specularNr = 1;
+    this->vertexCount = vertexCount;
+    this->indexCount = indexCount;
+    if(lods.empty())
+        lods.push_back(MeshLod{ 0, (uint32_t)indexCount, 0.0f });
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+  
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+    if(vertexFormat == VERTEX_FORMAT_COMPACT)
+    {
+        vector<CompactVertex> packed = packCompactVertices(vertexData, vertexCount, positionOffset, positionScale);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(CompactVertex), packed.data(), GL_STATIC_DRAW);
+    }
+    else
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertexData, GL_STATIC_DRAW);  
+
+    // Half the index bandwidth whenever every vertex is addressable in 16 bits
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    indexType = vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    if(indexType == GL_UNSIGNED_SHORT)
+    {
+        vector<uint16_t> shortIndices(indexData, indexData + indexCount);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(uint16_t), shortIndices.data(), GL_STATIC_DRAW);
+    }
+    else
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
+
+    setupVertexAttributes(vertexFormat);
+
+    glBindVertexArray(0);
+
+    // The shader samples the first diffuse and first specular map; any others are unused
+    for(unsigned int slot = 0; slot < MATERIAL_SLOT_COUNT; slot++)
+        materialTextures[slot] = 0;
 
     for(unsigned int i = 0; i < textures.size(); i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i);
+        if(textures[i].type == "texture_diffuse" && !materialTextures[MATERIAL_DIFFUSE])
+            materialTextures[MATERIAL_DIFFUSE] = textures[i].id;
+        else if(textures[i].type == "texture_specular" && !materialTextures[MATERIAL_SPECULAR])
+            materialTextures[MATERIAL_SPECULAR] = textures[i].id;
+    }
 
-        string number;
-        string name = textures[i].type;
+    // Without a specular map the diffuse map doubles as one, as it did when both samplers read unit 0
+    if(!materialTextures[MATERIAL_SPECULAR])
+        materialTextures[MATERIAL_SPECULAR] = materialTextures[MATERIAL_DIFFUSE];
+}
 
-        if(name == "texture_diffuse")
-            number = std::to_string(diffuseNr++);
-        else if(name == "texture_specular")
-            number = std::to_string(specularNr++);
+void Mesh::Draw(Shader &shader, unsigned int instanceCount)
+{
+    PROFILE_ZONE("Mesh::Draw");
 
-        shader.setInt(("material." + name + number).c_str(), i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+    bindMaterial();
+    if(vertexFormat == VERTEX_FORMAT_COMPACT)
+    {
+        PositionDecodeUniforms decode(shader);
+        shader.set(decode.offset, positionOffset);
+        shader.set(decode.scale, positionScale);
     }
 
-    glActiveTexture(GL_TEXTURE0);
     glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lods[0].indexCount, indexType, (void*)((firstIndex + lods[0].firstIndex) * indexSize(indexType)), instanceCount, baseVertex);
     glBindVertexArray(0);
-}  
+}
+
+void Mesh::bindMaterial() const
+{
+    for(unsigned int slot = 0; slot < MATERIAL_SLOT_COUNT; slot++)
+    {
+        glActiveTexture(GL_TEXTURE0 + slot);
+        glBindTexture(GL_TEXTURE_2D, materialTextures[slot]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+bool Mesh::sameMaterial(const Mesh &other) const
+{
+    for(unsigned int slot = 0; slot < MATERIAL_SLOT_COUNT; slot++)
+    {
+        if(materialTextures[slot] != other.materialTextures[slot])
+            return false;
+    }
+    return true;
+}
+
+void Mesh::replaceTexture(unsigned int from, unsigned int to)
+{
+    for(Texture &texture : textures)
+    {
+        if(texture.id == from)
+            texture.id = to;
+    }
+    for(unsigned int slot = 0; slot < MATERIAL_SLOT_COUNT; slot++)
+    {
+        if(materialTextures[slot] == from)
+            materialTextures[slot] = to;
+    }
+}
+
+bool Mesh::materialBefore(const Mesh &other) const
+{
+    for(unsigned int slot = 0; slot < MATERIAL_SLOT_COUNT; slot++)
+    {
+        if(materialTextures[slot] != other.materialTextures[slot])
+            return materialTextures[slot] < other.materialTextures[slot];
+    }
+    return false;
+}
+
+void Mesh::useSharedBuffers(unsigned int sharedVAO, unsigned int baseVertex, unsigned int firstIndex)
+{
+    deleteBuffers();
+
+    VAO = sharedVAO;
+    ownsVertexArray = false;
+    this->baseVertex = baseVertex;
+    this->firstIndex = firstIndex;
+}
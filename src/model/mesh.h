@@ -1,11 +1,13 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <assimp/scene.h>
 
 #include "../shader/shader.hpp"
 
+#include <cstdint>
 #include <string>
 #include <vector>
 using namespace std;
@@ -17,6 +19,62 @@ struct Vertex
     glm::vec2 TexCoords;
 };
 
+// GPU side vertex layouts. Meshes are always imported and cached as Vertex; the compact
+// layout is packed at upload and needs shaders compiled with COMPACT_VERTICES.
+enum VertexFormat
+{
+    VERTEX_FORMAT_FLOAT,
+    VERTEX_FORMAT_COMPACT
+};
+
+// 16 bytes: position as 16 bit unorm within the mesh bounds (w unused), octahedral normal
+// in the x and y of a 2_10_10_10 snorm, texture coordinates as half floats
+struct CompactVertex
+{
+    uint16_t Position[4];
+    uint32_t Normal;
+    uint16_t TexCoords[2];
+};
+
+// Per draw position decode of shaders/shader.vert.glsl, resolved from the shader a draw is
+// given; each is an array of MAX_MULTI_DRAW_MESHES indexed by gl_DrawID, object position =
+// offset + scale * unorm
+struct PositionDecodeUniforms
+{
+    Uniform<glm::vec3> offset;
+    Uniform<glm::vec3> scale;
+
+    explicit PositionDecodeUniforms(const Shader &shader)
+        : offset(shader.uniform<glm::vec3>("positionOffset")), scale(shader.uniform<glm::vec3>("positionScale")) {}
+};
+
+size_t vertexStride(VertexFormat format);
+size_t indexSize(GLenum indexType);
+
+// Texture units for the layout(binding = N) material samplers in shaders/shader.frag.glsl.
+// A mesh's textures are assigned to slots once at load time and bound to the slot's unit
+// before its draws. gl_DrawID is not dynamically uniform in the fragment stage, so it cannot
+// pick a sampler there: a multi-draw only spans meshes sharing a material.
+enum MaterialSlot
+{
+    MATERIAL_DIFFUSE = 0,
+    MATERIAL_SPECULAR = 1,
+    MATERIAL_SLOT_COUNT
+};
+
+// Meshes per multi-draw, the length of the per draw position decode arrays
+const unsigned int MAX_MULTI_DRAW_MESHES = 8;
+
+// One level of detail: a range of the mesh's index buffer drawing a simplified surface over
+// the same vertices. Level 0 is the full mesh.
+struct MeshLod
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    // Furthest the simplified surface strays from level 0, in object space units
+    float error;
+};
+
 struct Texture 
 {
     unsigned int id;
@@ -24,20 +82,75 @@ struct Texture
     aiString path;
 };
 
+// Describes the vertex layout for the currently bound VAO and GL_ARRAY_BUFFER
+void setupVertexAttributes(VertexFormat format = VERTEX_FORMAT_FLOAT);
+
+// Owns its GL buffers, so it can be moved but not copied
 class Mesh 
 {
     public:
+        // CPU copies of the uploaded geometry, empty after releaseCpuData() or when built from caller-owned memory
         vector<Vertex> vertices;
         vector<unsigned int> indices;
         vector<Texture> textures;
 
-        Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures);
-        void Draw(Shader &shader);
+        // Takes ownership of the arrays; pass them with std::move to avoid copying the geometry.
+        // The indices hold every level in lods back to back; no lods means one level over all of them.
+        Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexFormat format = VERTEX_FORMAT_FLOAT, vector<MeshLod> lods = vector<MeshLod>());
+        // Uploads straight from caller-owned memory (e.g. a mapped mesh cache) without keeping CPU copies
+        Mesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount, vector<Texture> textures, VertexFormat format = VERTEX_FORMAT_FLOAT, vector<MeshLod> lods = vector<MeshLod>());
+        ~Mesh();
+        Mesh(const Mesh&) = delete;
+        Mesh& operator=(const Mesh&) = delete;
+        Mesh(Mesh &&other) noexcept;
+        Mesh& operator=(Mesh &&other) noexcept;
+
+        // Draws level 0
+        void Draw(Shader &shader, unsigned int instanceCount = 1);
+        // Frees the CPU copies once nothing needs them, the GPU buffers are unaffected
+        void releaseCpuData();
+        // Binds this mesh's textures to their material units
+        void bindMaterial() const;
+        // Whether both meshes bind the same textures, so one multi-draw can cover them
+        bool sameMaterial(const Mesh &other) const;
+        // A consistent order over materials, for sorting meshes that share one next to each other
+        bool materialBefore(const Mesh &other) const;
+        // Points every use of one texture name at another
+        void replaceTexture(unsigned int from, unsigned int to);
+
+        // Replaces this mesh's own buffers with a range of buffers shared across its model
+        void useSharedBuffers(unsigned int sharedVAO, unsigned int baseVertex, unsigned int firstIndex);
+        unsigned int vertexBuffer() const { return VBO; }
+        unsigned int indexBuffer() const { return EBO; }
+        unsigned int getVertexCount() const { return vertexCount; }
+        unsigned int getIndexCount() const { return indexCount; }
+        VertexFormat getVertexFormat() const { return vertexFormat; }
+        // GL_UNSIGNED_SHORT when every vertex fits in 16 bits, otherwise GL_UNSIGNED_INT
+        GLenum getIndexType() const { return indexType; }
+        glm::vec3 getPositionOffset() const { return positionOffset; }
+        glm::vec3 getPositionScale() const { return positionScale; }
+        const vector<MeshLod>& getLods() const { return lods; }
 
     private:
-        unsigned int VAO, VBO, EBO;
+        unsigned int VAO = 0, VBO = 0, EBO = 0;
+        // False once the mesh draws from its model's shared vertex array
+        bool ownsVertexArray = true;
+        unsigned int vertexCount;
+        unsigned int indexCount;
+        vector<MeshLod> lods;
+        unsigned int baseVertex = 0;
+        unsigned int firstIndex = 0;
+        VertexFormat vertexFormat;
+        GLenum indexType;
+        // Compact positions decode as positionOffset + positionScale * unorm
+        glm::vec3 positionOffset = glm::vec3(0.0f);
+        glm::vec3 positionScale = glm::vec3(1.0f);
+
+        // Texture bound to each material unit, 0 where the mesh has none
+        unsigned int materialTextures[MATERIAL_SLOT_COUNT];
 
-        void setupMesh();
+        void deleteBuffers();
+        void setupMesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount);
 };
 
 #endif
@@ -0,0 +1,273 @@
+#include "mesh_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char MESH_CACHE_MAGIC[8] = { 'M', 'E', 'S', 'H', 'C', 'A', 'C', 'H' };
+
+struct MeshCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t importFlags;
+    int64_t sourceMtime;
+    uint64_t sourceSize;
+    uint32_t pathLength;
+    uint32_t meshCount;
+};
+
+struct MeshCacheRecord
+{
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t textureOffset;
+    uint64_t lodOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureCount;
+    uint32_t lodCount;
+};
+
+static bool statSource(const string &path, int64_t &mtime, uint64_t &size)
+{
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0)
+        return false;
+
+    mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    size = st.st_size;
+    return true;
+}
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+string meshCachePath(const string &sourcePath)
+{
+    return sourcePath + ".meshcache";
+}
+
+MeshCacheFile::MeshCacheFile() : mapping(MAP_FAILED), mappingSize(0)
+{
+}
+
+MeshCacheFile::~MeshCacheFile()
+{
+    close();
+}
+
+void MeshCacheFile::close()
+{
+    if(mapping != MAP_FAILED)
+        munmap(mapping, mappingSize);
+
+    mapping = MAP_FAILED;
+    mappingSize = 0;
+    meshes.clear();
+}
+
+bool MeshCacheFile::open(const string &sourcePath, unsigned int importFlags)
+{
+    close();
+
+    int64_t mtime;
+    uint64_t size;
+    if(!statSource(sourcePath, mtime, size))
+        return false;
+
+    int fd = ::open(meshCachePath(sourcePath).c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(MeshCacheHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    mappingSize = st.st_size;
+    mapping = mmap(NULL, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(mapping == MAP_FAILED)
+        return false;
+
+    const char *base = (const char*)mapping;
+    MeshCacheHeader header;
+    memcpy(&header, base, sizeof(header));
+
+    bool fresh = memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) == 0
+        && header.version == MESH_CACHE_VERSION
+        && header.importFlags == importFlags
+        && header.sourceMtime == mtime
+        && header.sourceSize == size
+        && sizeof(header) + header.pathLength <= mappingSize
+        && sourcePath.compare(0, string::npos, base + sizeof(header), header.pathLength) == 0;
+
+    size_t recordOffset = alignUp(sizeof(header) + header.pathLength, 8);
+    if(!fresh || recordOffset + (uint64_t)header.meshCount * sizeof(MeshCacheRecord) > mappingSize)
+    {
+        close();
+        return false;
+    }
+
+    for(uint32_t i = 0; i < header.meshCount; i++)
+    {
+        MeshCacheRecord record;
+        memcpy(&record, base + recordOffset + i * sizeof(MeshCacheRecord), sizeof(record));
+
+        if(record.vertexOffset + (uint64_t)record.vertexCount * sizeof(Vertex) > mappingSize
+            || record.indexOffset + (uint64_t)record.indexCount * sizeof(unsigned int) > mappingSize
+            || record.lodOffset + (uint64_t)record.lodCount * sizeof(MeshLod) > mappingSize)
+        {
+            close();
+            return false;
+        }
+
+        CachedMesh mesh;
+        mesh.vertices = (const Vertex*)(base + record.vertexOffset);
+        mesh.vertexCount = record.vertexCount;
+        mesh.indices = (const unsigned int*)(base + record.indexOffset);
+        mesh.indexCount = record.indexCount;
+        mesh.lods.resize(record.lodCount);
+        if(record.lodCount > 0)
+            memcpy(mesh.lods.data(), base + record.lodOffset, record.lodCount * sizeof(MeshLod));
+        for(const MeshLod &lod : mesh.lods)
+        {
+            if((uint64_t)lod.firstIndex + lod.indexCount > record.indexCount)
+            {
+                close();
+                return false;
+            }
+        }
+
+        uint64_t cursor = record.textureOffset;
+        for(uint32_t t = 0; t < record.textureCount; t++)
+        {
+            uint32_t lengths[2];
+            if(cursor + sizeof(lengths) > mappingSize)
+            {
+                close();
+                return false;
+            }
+            memcpy(lengths, base + cursor, sizeof(lengths));
+            cursor += sizeof(lengths);
+
+            if(cursor + lengths[0] + lengths[1] > mappingSize)
+            {
+                close();
+                return false;
+            }
+
+            CachedTexture texture;
+            texture.type.assign(base + cursor, lengths[0]);
+            texture.path.assign(base + cursor + lengths[0], lengths[1]);
+            cursor += lengths[0] + lengths[1];
+            mesh.textures.push_back(texture);
+        }
+
+        meshes.push_back(mesh);
+    }
+
+    return true;
+}
+
+bool writeMeshCache(const string &sourcePath, unsigned int importFlags, const vector<CachedMesh> &meshes)
+{
+    MeshCacheHeader header;
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MESH_CACHE_VERSION;
+    header.importFlags = importFlags;
+    header.pathLength = sourcePath.size();
+    header.meshCount = meshes.size();
+    if(!statSource(sourcePath, header.sourceMtime, header.sourceSize))
+        return false;
+
+    // Lay out records and texture strings first, then the 16 byte aligned geometry blobs
+    vector<MeshCacheRecord> records(meshes.size());
+    size_t recordOffset = alignUp(sizeof(header) + header.pathLength, 8);
+    size_t cursor = recordOffset + records.size() * sizeof(MeshCacheRecord);
+
+    for(size_t i = 0; i < meshes.size(); i++)
+    {
+        records[i].textureOffset = cursor;
+        records[i].textureCount = meshes[i].textures.size();
+        for(const CachedTexture &texture : meshes[i].textures)
+            cursor += 2 * sizeof(uint32_t) + texture.type.size() + texture.path.size();
+    }
+
+    for(size_t i = 0; i < meshes.size(); i++)
+    {
+        cursor = alignUp(cursor, 4);
+        records[i].lodOffset = cursor;
+        records[i].lodCount = meshes[i].lods.size();
+        cursor += meshes[i].lods.size() * sizeof(MeshLod);
+    }
+
+    for(size_t i = 0; i < meshes.size(); i++)
+    {
+        cursor = alignUp(cursor, 16);
+        records[i].vertexOffset = cursor;
+        records[i].vertexCount = meshes[i].vertexCount;
+        cursor += meshes[i].vertexCount * sizeof(Vertex);
+
+        cursor = alignUp(cursor, 16);
+        records[i].indexOffset = cursor;
+        records[i].indexCount = meshes[i].indexCount;
+        cursor += meshes[i].indexCount * sizeof(unsigned int);
+    }
+
+    vector<char> buffer(cursor, 0);
+    memcpy(&buffer[0], &header, sizeof(header));
+    memcpy(&buffer[sizeof(header)], sourcePath.data(), sourcePath.size());
+    memcpy(&buffer[recordOffset], records.data(), records.size() * sizeof(MeshCacheRecord));
+
+    for(size_t i = 0; i < meshes.size(); i++)
+    {
+        char *out = &buffer[records[i].textureOffset];
+        for(const CachedTexture &texture : meshes[i].textures)
+        {
+            uint32_t lengths[2] = { (uint32_t)texture.type.size(), (uint32_t)texture.path.size() };
+            memcpy(out, lengths, sizeof(lengths));
+            memcpy(out + sizeof(lengths), texture.type.data(), lengths[0]);
+            memcpy(out + sizeof(lengths) + lengths[0], texture.path.data(), lengths[1]);
+            out += sizeof(lengths) + lengths[0] + lengths[1];
+        }
+
+        if(!meshes[i].lods.empty())
+            memcpy(&buffer[records[i].lodOffset], meshes[i].lods.data(), meshes[i].lods.size() * sizeof(MeshLod));
+        if(meshes[i].vertexCount > 0)
+            memcpy(&buffer[records[i].vertexOffset], meshes[i].vertices, meshes[i].vertexCount * sizeof(Vertex));
+        if(meshes[i].indexCount > 0)
+            memcpy(&buffer[records[i].indexOffset], meshes[i].indices, meshes[i].indexCount * sizeof(unsigned int));
+    }
+
+    // Write beside the final name and rename so readers never map a half written file
+    string path = meshCachePath(sourcePath);
+    string temporary = path + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if(!file)
+    {
+        cout << "ERROR::MESH_CACHE::CANNOT_WRITE " << temporary << endl;
+        return false;
+    }
+
+    bool written = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    written = fclose(file) == 0 && written;
+    if(!written || rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        cout << "ERROR::MESH_CACHE::CANNOT_WRITE " << path << endl;
+        remove(temporary.c_str());
+        return false;
+    }
+
+    return true;
+}
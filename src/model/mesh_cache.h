@@ -0,0 +1,59 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "mesh.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Binary snapshot of an imported model, stored next to the source as "<source>.meshcache".
+// It is keyed by source path, mtime, size and import flags; any mismatch or a version bump
+// makes it stale and the model is re-imported through Assimp.
+const uint32_t MESH_CACHE_VERSION = 3;
+
+struct CachedTexture
+{
+    string type;
+    string path;
+};
+
+// Views into the mapped cache file, valid while the MeshCacheFile is open, or into
+// geometry still being imported.
+struct CachedMesh
+{
+    const Vertex *vertices;
+    uint32_t vertexCount;
+    // Every level of detail back to back, as described by lods
+    const unsigned int *indices;
+    uint32_t indexCount;
+    vector<CachedTexture> textures;
+    vector<MeshLod> lods;
+};
+
+class MeshCacheFile
+{
+    public:
+        vector<CachedMesh> meshes;
+
+        MeshCacheFile();
+        ~MeshCacheFile();
+        MeshCacheFile(const MeshCacheFile&) = delete;
+        MeshCacheFile& operator=(const MeshCacheFile&) = delete;
+
+        // Maps the cache for sourcePath; false if it is missing, corrupt or stale.
+        bool open(const string &sourcePath, unsigned int importFlags);
+
+    private:
+        void *mapping;
+        size_t mappingSize;
+
+        void close();
+};
+
+string meshCachePath(const string &sourcePath);
+// Meshes are views so that both freshly imported and mapped geometry can be written
+bool writeMeshCache(const string &sourcePath, unsigned int importFlags, const vector<CachedMesh> &meshes);
+
+#endif
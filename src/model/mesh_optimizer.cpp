@@ -0,0 +1,318 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+// LRU cache size the Forsyth scores are tuned for
+const unsigned int FORSYTH_CACHE_SIZE = 32;
+const unsigned int NO_VERTEX = ~0u;
+
+VertexCacheStats analyzeVertexCache(const vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize)
+{
+    VertexCacheStats stats = {};
+    if(indices.empty())
+        return stats;
+
+    // A vertex is cached while fewer than cacheSize misses have been pushed in after it
+    vector<unsigned int> insertedAt(vertexCount, NO_VERTEX);
+    unsigned int referenced = 0;
+    for(unsigned int index : indices)
+    {
+        if(insertedAt[index] == NO_VERTEX)
+            referenced++;
+        else if(stats.transformed - insertedAt[index] < cacheSize)
+            continue;
+
+        insertedAt[index] = stats.transformed++;
+    }
+
+    stats.acmr = (float)stats.transformed / (indices.size() / 3);
+    stats.atvr = (float)stats.transformed / referenced;
+    return stats;
+}
+
+struct VertexBitsHash
+{
+    size_t operator()(const Vertex &vertex) const
+    {
+        // FNV-1a over the raw bytes; Vertex is tightly packed floats
+        const unsigned char *bytes = (const unsigned char*)&vertex;
+        uint64_t hash = 14695981039346656037ull;
+        for(size_t i = 0; i < sizeof(Vertex); i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        return hash;
+    }
+};
+
+struct VertexBitsEqual
+{
+    bool operator()(const Vertex &a, const Vertex &b) const
+    {
+        return memcmp(&a, &b, sizeof(Vertex)) == 0;
+    }
+};
+
+size_t weldVertices(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    unordered_map<Vertex, unsigned int, VertexBitsHash, VertexBitsEqual> unique;
+    unique.reserve(vertices.size());
+
+    vector<unsigned int> remap(vertices.size());
+    vector<Vertex> welded;
+    welded.reserve(vertices.size());
+    for(size_t i = 0; i < vertices.size(); i++)
+    {
+        auto inserted = unique.emplace(vertices[i], (unsigned int)welded.size());
+        if(inserted.second)
+            welded.push_back(vertices[i]);
+        remap[i] = inserted.first->second;
+    }
+
+    for(unsigned int &index : indices)
+        index = remap[index];
+
+    vertices.swap(welded);
+    return vertices.size();
+}
+
+static float forsythVertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+    if(remainingTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if(cachePosition >= 0)
+    {
+        // The last triangle's vertices score a fixed amount so the next one does not just reuse them
+        if(cachePosition < 3)
+            score = 0.75f;
+        else
+            score = pow(1.0f - (cachePosition - 3) / (float)(FORSYTH_CACHE_SIZE - 3), 1.5f);
+    }
+
+    // Finish off vertices with few triangles left so they can leave the cache for good
+    return score + 2.0f * pow((float)remainingTriangles, -0.5f);
+}
+
+void optimizeVertexCache(vector<unsigned int> &indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    if(triangleCount == 0)
+        return;
+
+    // Triangles around each vertex; the live ones are kept at the front of each range
+    vector<unsigned int> remaining(vertexCount, 0);
+    for(unsigned int index : indices)
+        remaining[index]++;
+
+    vector<unsigned int> offsets(vertexCount + 1, 0);
+    for(size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+
+    vector<unsigned int> adjacency(indices.size());
+    vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for(size_t i = 0; i < indices.size(); i++)
+        adjacency[fill[indices[i]]++] = i / 3;
+
+    vector<int> cachePosition(vertexCount, -1);
+    vector<float> vertexScore(vertexCount);
+    for(size_t v = 0; v < vertexCount; v++)
+        vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+
+    vector<bool> emitted(triangleCount, false);
+
+    vector<unsigned int> output;
+    output.reserve(indices.size());
+    vector<unsigned int> cache, nextCache;
+    size_t scanCursor = 0;
+    long best = 0;
+
+    for(size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+    {
+        // Dead end: nothing left around the cache, restart from the next unemitted triangle
+        if(best < 0)
+        {
+            while(emitted[scanCursor])
+                scanCursor++;
+            best = scanCursor;
+        }
+
+        const unsigned int *triangle = &indices[best * 3];
+        output.insert(output.end(), triangle, triangle + 3);
+        emitted[best] = true;
+
+        nextCache.clear();
+        for(unsigned int k = 0; k < 3; k++)
+        {
+            // Drop the triangle from the vertex's live range, once per corner so degenerate
+            // triangles that repeat a vertex leave nothing behind
+            unsigned int v = triangle[k];
+            unsigned int *live = &adjacency[offsets[v]];
+            unsigned int *last = live + remaining[v] - 1;
+            *find(live, last + 1, (unsigned int)best) = *last;
+            remaining[v]--;
+
+            if(find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+                nextCache.push_back(v);
+        }
+        for(unsigned int v : cache)
+            if(find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+                nextCache.push_back(v);
+
+        // Rescore everything whose cache position moved, including vertices pushed out
+        for(size_t i = 0; i < nextCache.size(); i++)
+        {
+            unsigned int v = nextCache[i];
+            cachePosition[v] = i < FORSYTH_CACHE_SIZE ? (int)i : -1;
+            vertexScore[v] = forsythVertexScore(cachePosition[v], remaining[v]);
+        }
+
+        best = -1;
+        float bestScore = -1.0f;
+        for(unsigned int v : nextCache)
+        {
+            for(unsigned int i = offsets[v]; i < offsets[v] + remaining[v]; i++)
+            {
+                unsigned int t = adjacency[i];
+                float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                if(score > bestScore)
+                {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+
+        if(nextCache.size() > FORSYTH_CACHE_SIZE)
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        cache.swap(nextCache);
+    }
+
+    indices.swap(output);
+}
+
+struct TriangleCluster
+{
+    unsigned int firstTriangle;
+    unsigned int triangleCount;
+    float sortKey;
+};
+
+void optimizeOverdraw(vector<unsigned int> &indices, const vector<Vertex> &vertices, float threshold)
+{
+    size_t triangleCount = indices.size() / 3;
+    if(triangleCount == 0)
+        return;
+
+    // Split where the cache order already restarts, a triangle with no cached vertex, so
+    // moving whole clusters around costs next to nothing in cache hits
+    vector<TriangleCluster> clusters;
+    vector<unsigned int> insertedAt(vertices.size(), NO_VERTEX);
+    unsigned int misses = 0;
+    for(size_t t = 0; t < triangleCount; t++)
+    {
+        unsigned int triangleMisses = 0;
+        for(unsigned int k = 0; k < 3; k++)
+        {
+            unsigned int v = indices[t * 3 + k];
+            if(insertedAt[v] == NO_VERTEX || misses - insertedAt[v] >= VERTEX_CACHE_ANALYSIS_SIZE)
+            {
+                insertedAt[v] = misses++;
+                triangleMisses++;
+            }
+        }
+
+        if(t == 0 || triangleMisses == 3)
+            clusters.push_back({ (unsigned int)t, 0, 0.0f });
+        clusters.back().triangleCount++;
+    }
+
+    if(clusters.size() < 2)
+        return;
+
+    // Area weighted centroid and normal of each cluster and of the whole mesh
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    vector<glm::vec3> centroids(clusters.size()), normals(clusters.size());
+    for(size_t c = 0; c < clusters.size(); c++)
+    {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for(unsigned int t = clusters[c].firstTriangle; t < clusters[c].firstTriangle + clusters[c].triangleCount; t++)
+        {
+            glm::vec3 a = vertices[indices[t * 3]].Position;
+            glm::vec3 b = vertices[indices[t * 3 + 1]].Position;
+            glm::vec3 d = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 cross = glm::cross(b - a, d - a);
+            float triangleArea = glm::length(cross);
+
+            centroid += (a + b + d) / 3.0f * triangleArea;
+            normal += cross;
+            area += triangleArea;
+        }
+
+        meshCentroid += centroid;
+        meshArea += area;
+        centroids[c] = area > 0.0f ? centroid / area : centroid;
+        normals[c] = glm::length(normal) > 0.0f ? glm::normalize(normal) : normal;
+    }
+    if(meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // Clusters facing away from the middle occlude the rest from outside, so they go first
+    for(size_t c = 0; c < clusters.size(); c++)
+        clusters[c].sortKey = glm::dot(centroids[c] - meshCentroid, normals[c]);
+    stable_sort(clusters.begin(), clusters.end(), [](const TriangleCluster &a, const TriangleCluster &b) { return a.sortKey > b.sortKey; });
+
+    vector<unsigned int> reordered;
+    reordered.reserve(indices.size());
+    for(const TriangleCluster &cluster : clusters)
+        reordered.insert(reordered.end(), indices.begin() + cluster.firstTriangle * 3, indices.begin() + (cluster.firstTriangle + cluster.triangleCount) * 3);
+
+    float cacheOrdered = analyzeVertexCache(indices, vertices.size()).acmr;
+    if(analyzeVertexCache(reordered, vertices.size()).acmr <= cacheOrdered * threshold)
+        indices.swap(reordered);
+}
+
+void optimizeVertexFetch(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    vector<unsigned int> remap(vertices.size(), NO_VERTEX);
+    vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+
+    // Vertices no triangle references are dropped here
+    for(unsigned int &index : indices)
+    {
+        if(remap[index] == NO_VERTEX)
+        {
+            remap[index] = reordered.size();
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices.swap(reordered);
+}
+
+void optimizeMesh(vector<Vertex> &vertices, vector<unsigned int> &indices, const string &name)
+{
+    auto start = chrono::steady_clock::now();
+    size_t originalVertices = vertices.size();
+    VertexCacheStats before = analyzeVertexCache(indices, vertices.size());
+
+    weldVertices(vertices, indices);
+    optimizeVertexCache(indices, vertices.size());
+    optimizeOverdraw(indices, vertices);
+    optimizeVertexFetch(vertices, indices);
+
+    VertexCacheStats after = analyzeVertexCache(indices, vertices.size());
+    double totalMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "Optimized mesh " << (name.empty() ? "(unnamed)" : name) << ": " << originalVertices << " -> " << vertices.size()
+         << " vertices, ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr
+         << ", " << before.transformed << " -> " << after.transformed << " vertex shader runs per instance (" << totalMs << " ms)" << endl;
+}
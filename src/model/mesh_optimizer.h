@@ -0,0 +1,38 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include "mesh.h"
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// FIFO post-transform cache used to score index orders; 16 entries is a conservative
+// stand-in for current hardware, which reuses at least this much.
+const unsigned int VERTEX_CACHE_ANALYSIS_SIZE = 16;
+// Overdraw reordering is rejected if it costs more than this factor of the cache ordered ACMR
+const float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+struct VertexCacheStats
+{
+    unsigned int transformed;  // vertex shader invocations for one draw of the mesh
+    float acmr;                // transformed vertices per triangle, 0.5 is ideal, 3 is none reused
+    float atvr;                // transformed vertices per referenced vertex, 1 is ideal
+};
+
+VertexCacheStats analyzeVertexCache(const vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_ANALYSIS_SIZE);
+
+// Merges bitwise identical vertices and rewrites the indices to match. Returns the new vertex count.
+size_t weldVertices(vector<Vertex> &vertices, vector<unsigned int> &indices);
+// Reorders triangles for post-transform cache reuse (Forsyth, linear-speed vertex cache optimisation)
+void optimizeVertexCache(vector<unsigned int> &indices, size_t vertexCount);
+// Reorders clusters of cache ordered triangles so outward facing ones draw first, reducing
+// overdraw from most viewpoints while keeping the cache hits inside each cluster
+void optimizeOverdraw(vector<unsigned int> &indices, const vector<Vertex> &vertices, float threshold = OVERDRAW_ACMR_THRESHOLD);
+// Reorders vertices by first use so fetches walk the vertex buffer in order
+void optimizeVertexFetch(vector<Vertex> &vertices, vector<unsigned int> &indices);
+
+// Runs the whole pipeline above and prints before and after cache statistics
+void optimizeMesh(vector<Vertex> &vertices, vector<unsigned int> &indices, const string &name);
+
+#endif
@@ -0,0 +1,319 @@
+#include "mesh_simplifier.h"
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+// What a vertex may do during a pass: go anywhere along its edges, only along the open
+// border it lies on, or nothing (seams, where other vertices share its position)
+enum VertexKind
+{
+    VERTEX_MANIFOLD,
+    VERTEX_BORDER,
+    VERTEX_LOCKED
+};
+
+// Symmetric 4x4 matrix of a weighted sum of squared plane distances, plus the total weight
+struct Quadric
+{
+    double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+    double weight;
+};
+
+struct Collapse
+{
+    unsigned int from;
+    unsigned int to;
+    float error;
+};
+
+struct PositionBitsHash
+{
+    size_t operator()(const glm::vec3 &position) const
+    {
+        // FNV-1a over the raw bytes, matching positions exactly as the welder matches vertices
+        const unsigned char *bytes = (const unsigned char*)&position;
+        uint64_t hash = 14695981039346656037ull;
+        for(size_t i = 0; i < sizeof(glm::vec3); i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        return hash;
+    }
+};
+
+struct PositionBitsEqual
+{
+    bool operator()(const glm::vec3 &a, const glm::vec3 &b) const
+    {
+        return memcmp(&a, &b, sizeof(glm::vec3)) == 0;
+    }
+};
+
+static uint64_t edgeKey(unsigned int a, unsigned int b)
+{
+    return (uint64_t)a << 32 | b;
+}
+
+static void addPlane(Quadric &q, glm::vec3 normal, float distance, double weight)
+{
+    double a = normal.x, b = normal.y, c = normal.z, d = distance;
+    q.a00 += weight * a * a; q.a01 += weight * a * b; q.a02 += weight * a * c; q.a03 += weight * a * d;
+    q.a11 += weight * b * b; q.a12 += weight * b * c; q.a13 += weight * b * d;
+    q.a22 += weight * c * c; q.a23 += weight * c * d;
+    q.a33 += weight * d * d;
+    q.weight += weight;
+}
+
+static void addQuadric(Quadric &q, const Quadric &other)
+{
+    q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02; q.a03 += other.a03;
+    q.a11 += other.a11; q.a12 += other.a12; q.a13 += other.a13;
+    q.a22 += other.a22; q.a23 += other.a23;
+    q.a33 += other.a33;
+    q.weight += other.weight;
+}
+
+// Weighted RMS distance from p to the quadric's planes, in the mesh's units
+static float quadricDistance(const Quadric &q, glm::vec3 p)
+{
+    double x = p.x, y = p.y, z = p.z;
+    double error = q.a00 * x * x + 2.0 * q.a01 * x * y + 2.0 * q.a02 * x * z + 2.0 * q.a03 * x
+                 + q.a11 * y * y + 2.0 * q.a12 * y * z + 2.0 * q.a13 * y
+                 + q.a22 * z * z + 2.0 * q.a23 * z
+                 + q.a33;
+    return q.weight > 0.0 ? (float)sqrt(max(error, 0.0) / q.weight) : 0.0f;
+}
+
+static glm::vec3 triangleNormal(glm::vec3 a, glm::vec3 b, glm::vec3 c)
+{
+    return glm::cross(b - a, c - a);
+}
+
+// Whether moving from onto to folds any triangle around from over, or makes it a sliver
+static bool collapseFlips(const vector<Vertex> &vertices, const vector<unsigned int> &indices, const vector<unsigned int> &triangleOffsets,
+                          const vector<unsigned int> &vertexTriangles, unsigned int from, unsigned int to)
+{
+    glm::vec3 target = vertices[to].Position;
+    for(unsigned int i = triangleOffsets[from]; i < triangleOffsets[from + 1]; i++)
+    {
+        const unsigned int *triangle = &indices[vertexTriangles[i] * 3];
+        if(triangle[0] == to || triangle[1] == to || triangle[2] == to)
+            continue;
+
+        glm::vec3 corners[3], moved[3];
+        for(int k = 0; k < 3; k++)
+        {
+            corners[k] = vertices[triangle[k]].Position;
+            moved[k] = triangle[k] == from ? target : corners[k];
+        }
+
+        glm::vec3 before = triangleNormal(corners[0], corners[1], corners[2]);
+        glm::vec3 after = triangleNormal(moved[0], moved[1], moved[2]);
+        if(glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after))
+            return true;
+    }
+    return false;
+}
+
+vector<unsigned int> simplifyMesh(const vector<Vertex> &vertices, const vector<unsigned int> &indices, size_t targetIndexCount, float &error)
+{
+    size_t vertexCount = vertices.size();
+    error = 0.0f;
+
+    // Vertices that share a position are either side of a seam and never move
+    unordered_map<glm::vec3, unsigned int, PositionBitsHash, PositionBitsEqual> firstAtPosition;
+    vector<unsigned int> positionId(vertexCount);
+    vector<unsigned char> seam(vertexCount, 0);
+    for(size_t i = 0; i < vertexCount; i++)
+    {
+        auto inserted = firstAtPosition.emplace(vertices[i].Position, (unsigned int)i);
+        positionId[i] = inserted.first->second;
+        if(!inserted.second)
+            seam[i] = seam[positionId[i]] = 1;
+    }
+
+    // Directed edges by position: an edge without its reverse is an open border
+    unordered_map<uint64_t, unsigned int> edges;
+    auto countEdges = [&](const vector<unsigned int> &triangles) {
+        edges.clear();
+        for(size_t t = 0; t < triangles.size(); t += 3)
+        {
+            for(int k = 0; k < 3; k++)
+                edges[edgeKey(positionId[triangles[t + k]], positionId[triangles[t + (k + 1) % 3]])]++;
+        }
+    };
+    auto isBorder = [&](unsigned int a, unsigned int b) {
+        return edges.count(edgeKey(positionId[b], positionId[a])) == 0;
+    };
+
+    // Every vertex starts with the planes of its triangles, weighted by area, and border
+    // vertices also with planes through their border edges at right angles to the surface
+    vector<Quadric> quadrics(vertexCount, Quadric());
+    countEdges(indices);
+    for(size_t t = 0; t < indices.size(); t += 3)
+    {
+        glm::vec3 normal = triangleNormal(vertices[indices[t]].Position, vertices[indices[t + 1]].Position, vertices[indices[t + 2]].Position);
+        float area = glm::length(normal);
+        if(area == 0.0f)
+            continue;
+        normal = normal / area;
+
+        for(int k = 0; k < 3; k++)
+        {
+            unsigned int a = indices[t + k], b = indices[t + (k + 1) % 3];
+            addPlane(quadrics[a], normal, -glm::dot(normal, vertices[a].Position), 0.5 * area);
+
+            if(!isBorder(a, b))
+                continue;
+            glm::vec3 edge = vertices[b].Position - vertices[a].Position;
+            float length = glm::length(edge);
+            if(length == 0.0f)
+                continue;
+            glm::vec3 side = glm::normalize(glm::cross(edge / length, normal));
+            double weight = LOD_BORDER_WEIGHT * length * length;
+            addPlane(quadrics[a], side, -glm::dot(side, vertices[a].Position), weight);
+            addPlane(quadrics[b], side, -glm::dot(side, vertices[a].Position), weight);
+        }
+    }
+
+    vector<unsigned int> result = indices;
+    vector<unsigned int> remap(vertexCount);
+    vector<VertexKind> kinds(vertexCount);
+    vector<unsigned int> triangleOffsets(vertexCount + 1);
+    vector<unsigned int> vertexTriangles;
+    vector<unsigned char> touched(vertexCount);
+    vector<Collapse> collapses;
+
+    // Each pass takes the cheapest collapses that do not touch each other, then rebuilds
+    while(result.size() > targetIndexCount)
+    {
+        countEdges(result);
+        for(size_t i = 0; i < vertexCount; i++)
+            kinds[i] = seam[i] ? VERTEX_LOCKED : VERTEX_MANIFOLD;
+        for(const auto &edge : edges)
+        {
+            unsigned int a = edge.first >> 32, b = edge.first & 0xFFFFFFFF;
+            // Non-manifold edges are left alone entirely
+            VertexKind kind = edge.second > 1 ? VERTEX_LOCKED : VERTEX_BORDER;
+            if(kind == VERTEX_LOCKED || edges.count(edgeKey(b, a)) == 0)
+            {
+                kinds[a] = max(kinds[a], kind);
+                kinds[b] = max(kinds[b], kind);
+            }
+        }
+
+        // Both directions of every edge; interior edges come up twice, the repeat is skipped below
+        collapses.clear();
+        auto consider = [&](unsigned int from, unsigned int to) {
+            if(kinds[from] == VERTEX_LOCKED)
+                return;
+            if(kinds[from] == VERTEX_BORDER && (kinds[to] == VERTEX_MANIFOLD || !(isBorder(from, to) || isBorder(to, from))))
+                return;
+
+            Quadric combined = quadrics[from];
+            addQuadric(combined, quadrics[to]);
+            collapses.push_back(Collapse{ from, to, quadricDistance(combined, vertices[to].Position) });
+        };
+        for(size_t t = 0; t < result.size(); t += 3)
+        {
+            for(int k = 0; k < 3; k++)
+            {
+                unsigned int a = result[t + k], b = result[t + (k + 1) % 3];
+                consider(a, b);
+                consider(b, a);
+            }
+        }
+        sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) { return a.error < b.error; });
+
+        fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for(unsigned int index : result)
+            triangleOffsets[index + 1]++;
+        for(size_t i = 0; i < vertexCount; i++)
+            triangleOffsets[i + 1] += triangleOffsets[i];
+        vertexTriangles.resize(result.size());
+        vector<unsigned int> cursor(triangleOffsets.begin(), triangleOffsets.end() - 1);
+        for(size_t i = 0; i < result.size(); i++)
+            vertexTriangles[cursor[result[i]]++] = i / 3;
+
+        for(size_t i = 0; i < vertexCount; i++)
+            remap[i] = i;
+        fill(touched.begin(), touched.end(), 0);
+
+        // An interior collapse removes two triangles, a border collapse one
+        size_t removable = (result.size() - targetIndexCount) / 3;
+        size_t removed = 0;
+        for(const Collapse &collapse : collapses)
+        {
+            if(removed >= removable)
+                break;
+            if(touched[collapse.from] || touched[collapse.to])
+                continue;
+            if(collapseFlips(vertices, result, triangleOffsets, vertexTriangles, collapse.from, collapse.to))
+                continue;
+
+            // Everything around the moved vertex is now stale for this pass
+            for(unsigned int i = triangleOffsets[collapse.from]; i < triangleOffsets[collapse.from + 1]; i++)
+            {
+                const unsigned int *triangle = &result[vertexTriangles[i] * 3];
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+            }
+            remap[collapse.from] = collapse.to;
+            addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+            error = max(error, collapse.error);
+            removed += kinds[collapse.from] == VERTEX_BORDER ? 1 : 2;
+        }
+        if(removed == 0)
+            break;
+
+        size_t kept = 0;
+        for(size_t t = 0; t < result.size(); t += 3)
+        {
+            unsigned int a = remap[result[t]], b = remap[result[t + 1]], c = remap[result[t + 2]];
+            if(a == b || b == c || a == c)
+                continue;
+            result[kept++] = a;
+            result[kept++] = b;
+            result[kept++] = c;
+        }
+        result.resize(kept);
+    }
+
+    return result;
+}
+
+void generateLods(const vector<Vertex> &vertices, vector<unsigned int> &indices, vector<MeshLod> &lods, const string &name)
+{
+    auto start = chrono::steady_clock::now();
+    lods.clear();
+    lods.push_back(MeshLod{ 0, (uint32_t)indices.size(), 0.0f });
+
+    const vector<unsigned int> base = indices;
+    ostringstream triangles, errors;
+    triangles << base.size() / 3;
+    errors << 0;
+    for(unsigned int level = 1; level < MAX_LOD_LEVELS; level++)
+    {
+        size_t previous = lods.back().indexCount;
+        size_t target = (size_t)(previous / 3 * LOD_TRIANGLE_RATIO) * 3;
+        float error;
+        vector<unsigned int> simplified = simplifyMesh(vertices, base, target, error);
+        if(simplified.empty() || simplified.size() > previous * LOD_MIN_REDUCTION)
+            break;
+
+        optimizeVertexCache(simplified, vertices.size());
+        // Errors only grow with the level, so selection can stop at the first one that is too coarse
+        lods.push_back(MeshLod{ (uint32_t)indices.size(), (uint32_t)simplified.size(), max(error, lods.back().error) });
+        indices.insert(indices.end(), simplified.begin(), simplified.end());
+        triangles << " -> " << simplified.size() / 3;
+        errors << " -> " << lods.back().error;
+    }
+
+    double totalMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "LODs for mesh " << (name.empty() ? "(unnamed)" : name) << ": " << triangles.str() << " triangles, error "
+         << errors.str() << " (" << totalMs << " ms)" << endl;
+}
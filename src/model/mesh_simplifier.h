@@ -0,0 +1,29 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include "mesh.h"
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// Levels generated per mesh at import, level 0 included
+const unsigned int MAX_LOD_LEVELS = 4;
+// Each level aims for this fraction of the previous level's triangles
+const float LOD_TRIANGLE_RATIO = 0.5f;
+// A level keeping more than this fraction of the previous one's triangles is not worth a draw
+const float LOD_MIN_REDUCTION = 0.8f;
+// Quadric weight of the planes holding open borders in place, relative to the surface
+const float LOD_BORDER_WEIGHT = 10.0f;
+
+// Collapses edges by quadric error (Garland and Heckbert) until at most targetIndexCount
+// indices remain or nothing more can go. Vertices only ever move onto other vertices, so the
+// result indexes the same vertex buffer. Open borders only slide along themselves and UV or
+// normal seams stay put. error receives the largest distance any vertex moved off the surface.
+vector<unsigned int> simplifyMesh(const vector<Vertex> &vertices, const vector<unsigned int> &indices, size_t targetIndexCount, float &error);
+
+// Appends levels 1 and up to indices, each simplified from level 0 and cache optimized, and
+// describes every level (level 0 first) in lods
+void generateLods(const vector<Vertex> &vertices, vector<unsigned int> &indices, vector<MeshLod> &lods, const string &name);
+
+#endif
@@ -1,61 +1,65 @@
 #include "model.h"
-
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "../util/profiler.hpp"
+#include "../util/thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <numeric>
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "../stb_image.h"
-
-unsigned int TextureFromFile(const char* str, string directory);
+const unsigned int IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs;
 
-Model::Model(char* path)
+// A mesh as imported, before it is uploaded or cached
+struct ImportedMesh
 {
-    loadModel(path);
-}
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    vector<CachedTexture> textures;
+    vector<MeshLod> lods;
+};
 
- void Model::Draw(Shader &shader)
+// Everything the GL thread needs to build a model. The meshes are views, either into the
+// mapped cache or into the imported meshes, so both load paths upload the same way.
+struct ModelSource
 {
-    for(unsigned int i = 0; i < meshes.size(); i++)
-        meshes[i].Draw(shader);
-}
-
-void Model::loadModel(string path)
+    bool valid = false;
+    MeshCacheFile cache;
+    vector<ImportedMesh> imported;
+    vector<CachedMesh> meshes;
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+};
+
+static vector<CachedTexture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
 {
-    Assimp::Importer import;
-    const aiScene *scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
-
-    if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) 
-    {
-        cout << "ERROR::ASSIMP::" << import.GetErrorString() << endl;
-        return;
-    }
-    directory = path.substr(0, path.find_last_of('/'));
-
-    processNode(scene->mRootNode, scene);
-}
+    vector<CachedTexture> textures;
 
-void Model::processNode(aiNode *node, const aiScene *scene)
-{
-    for(unsigned int i = 0; i < node->mNumMeshes; i++)
+    for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
     {
-        aiMesh *mesh = scene->mMeshes[node->mMeshes[i]]; 
-        meshes.push_back(processMesh(mesh, scene));			
+        aiString str;
+        mat->GetTexture(type, i, &str);
+        CachedTexture texture;
+        texture.type = typeName;
+        texture.path = str.C_Str();
+        textures.push_back(texture);
     }
 
-    for(unsigned int i = 0; i < node->mNumChildren; i++)
-    {
-        processNode(node->mChildren[i], scene);
-    }
+    return textures;
 }
 
-Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
+static ImportedMesh processMesh(aiMesh *mesh, const aiScene *scene)
 {
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
-    vector<Texture> textures;
+    ImportedMesh imported;
+    vector<Vertex> &vertices = imported.vertices;
+    vector<unsigned int> &indices = imported.indices;
+    vertices.reserve(mesh->mNumVertices);
+    indices.reserve(mesh->mNumFaces * 3);
 
     for(unsigned int i = 0; i < mesh->mNumVertices; i++)
     {
@@ -93,92 +97,561 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
             indices.push_back(face.mIndices[j]);
     }
 
+    // Assimp leaves one vertex per face corner; weld and reorder before anything is uploaded or cached
+    optimizeMesh(vertices, indices, mesh->mName.C_Str());
+    generateLods(vertices, indices, imported.lods, mesh->mName.C_Str());
+
     if(mesh->mMaterialIndex >= 0)
     {
         aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        vector<CachedTexture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+        imported.textures.insert(imported.textures.end(), diffuseMaps.begin(), diffuseMaps.end());
 
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        vector<CachedTexture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+        imported.textures.insert(imported.textures.end(), specularMaps.begin(), specularMaps.end());
     }
 
-    return Mesh(vertices, indices, textures);
+    return imported;
 }
 
-vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+static void processNode(aiNode *node, const aiScene *scene, vector<ImportedMesh> &meshes)
 {
-    vector<Texture> textures;
+    for(unsigned int i = 0; i < node->mNumMeshes; i++)
+    {
+        aiMesh *mesh = scene->mMeshes[node->mMeshes[i]]; 
+        meshes.push_back(processMesh(mesh, scene));			
+    }
 
-    for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+    for(unsigned int i = 0; i < node->mNumChildren; i++)
     {
-        aiString str;
-        mat->GetTexture(type, i, &str);
-        bool skip = false;
+        processNode(node->mChildren[i], scene, meshes);
+    }
+}
+
+// Worker side of a load: no GL, so it can run on the pool while the GL thread keeps drawing
+static unique_ptr<ModelSource> readModelSource(const string &path)
+{
+    PROFILE_ZONE("readModelSource");
+    unique_ptr<ModelSource> source(new ModelSource());
+
+    // Warm start: the mapped cache is the geometry, Assimp is never touched
+    if(source->cache.open(path, IMPORT_FLAGS))
+        source->meshes = source->cache.meshes;
+    else
+    {
+        Assimp::Importer import;
+        const aiScene *scene = import.ReadFile(path, IMPORT_FLAGS);
 
-        for(unsigned int j = 0; j < textures_loaded.size(); j++)
+        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) 
         {
-            if(std::strcmp(textures_loaded[j].path.C_Str(), str.C_Str()) == 0)
-            {
-                textures.push_back(textures_loaded[j]);
-                skip = true; 
-                break;
-            }
+            cout << "ERROR::ASSIMP::" << import.GetErrorString() << endl;
+            return source;
+        }
+
+        source->imported.reserve(scene->mNumMeshes);
+        processNode(scene->mRootNode, scene, source->imported);
+        // Everything needed is in the meshes now, give the imported scene back before caching
+        import.FreeScene();
+
+        for(const ImportedMesh &imported : source->imported)
+        {
+            CachedMesh mesh;
+            mesh.vertices = imported.vertices.data();
+            mesh.vertexCount = imported.vertices.size();
+            mesh.indices = imported.indices.data();
+            mesh.indexCount = imported.indices.size();
+            mesh.textures = imported.textures;
+            mesh.lods = imported.lods;
+            source->meshes.push_back(mesh);
         }
+        writeMeshCache(path, IMPORT_FLAGS, source->meshes);
+    }
 
-        if(!skip)
+    bool first = true;
+    for(const CachedMesh &mesh : source->meshes)
+    {
+        for(uint32_t i = 0; i < mesh.vertexCount; i++)
         {
-            Texture texture;
+            source->boundsMin = first ? mesh.vertices[i].Position : glm::min(source->boundsMin, mesh.vertices[i].Position);
+            source->boundsMax = first ? mesh.vertices[i].Position : glm::max(source->boundsMax, mesh.vertices[i].Position);
+            first = false;
+        }
+    }
+
+    source->valid = true;
+    return source;
+}
+
+Model::Model(const string &path, VertexFormat format, bool keepCpuData, ModelLoadMode loadMode) : vertexFormat(format), keepCpuData(keepCpuData)
+{
+    directory = path.substr(0, path.find_last_of('/'));
+    loadStart = chrono::steady_clock::now();
+
+    if(loadMode == MODEL_LOAD_ASYNC)
+        pendingSource = workerPool().submit([path]() { return readModelSource(path); });
+    else
+        loadModel(path);
+}
+
+Model::~Model()
+{
+    // The meshes delete their own buffers, the shared ones belong to the model; textures
+    // may be shared with other models, so only this model's references are given back.
+    // An import still running on the pool finishes on its own and is thrown away.
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &indirectBuffer);
+    glDeleteTextures(1, &placeholderTexture);
+    for(const auto &loaded : textures_loaded)
+        textureCache().release(loaded.second.id);
+}
+
+void Model::Draw(Shader &shader, const vector<LodBatch> &batches, unsigned int viewCount)
+{
+    PROFILE_ZONE("Model::Draw");
 
-            texture.id = TextureFromFile(str.C_Str(), directory);
-            texture.type = typeName;
-            texture.path = str.C_Str();
+    if(!ready)
+    {
+        unsigned int instanceCount = 0;
+        for(const LodBatch &batch : batches)
+            instanceCount += batch.instanceCount;
+        if(placeholder)
+            placeholder->Draw(shader, instanceCount * viewCount);
+        return;
+    }
+
+    if(drawCommands.empty())
+        return;
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
 
-            textures.push_back(texture);
-            textures_loaded.push_back(texture);
+    // Every mesh of a level draws that level's instances; the commands only change when the
+    // selection does
+    size_t meshCount = meshes.size();
+    unsigned int levels = min<size_t>(batches.size(), lodErrors.size());
+    bool changed = false;
+    for(unsigned int level = 0; level < lodErrors.size(); level++)
+    {
+        unsigned int instanceCount = level < levels ? batches[level].instanceCount * viewCount : 0;
+        unsigned int baseInstance = level < levels ? batches[level].firstInstance : 0;
+        for(size_t i = 0; i < meshCount; i++)
+        {
+            DrawElementsIndirectCommand &command = drawCommands[level * meshCount + i];
+            changed = changed || command.instanceCount != instanceCount || command.baseInstance != baseInstance;
+            command.instanceCount = instanceCount;
+            command.baseInstance = baseInstance;
         }
     }
+    if(changed || commandsWrittenOnGpu)
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, drawCommands.size() * sizeof(DrawElementsIndirectCommand), drawCommands.data());
+    commandsWrittenOnGpu = false;
 
-    return textures;
+    drawLevels(shader, levels, &batches);
+}
+
+void Model::DrawGenerated(Shader &shader)
+{
+    PROFILE_ZONE("Model::DrawGenerated");
+
+    if(!ready || drawCommands.empty())
+        return;
+
+    commandsWrittenOnGpu = true;
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    // The counts are only on the GPU, so every level is drawn; empty ones cost a command each
+    drawLevels(shader, lodErrors.size(), NULL);
+}
+
+// Expects the VAO and indirect buffer bound. batches, when known, lets empty levels be skipped.
+void Model::drawLevels(const Shader &shader, unsigned int levels, const vector<LodBatch> *batches)
+{
+    size_t meshCount = meshes.size();
+    PositionDecodeUniforms decode(shader);
+
+    // One multi-draw per level for each run of meshes sharing a material; the material is
+    // bound once and reused by every level
+    for(const MaterialRun &run : materialRuns)
+    {
+        meshes[run.firstMesh].bindMaterial();
+        if(vertexFormat == VERTEX_FORMAT_COMPACT)
+        {
+            shader.set(decode.offset, &positionOffsets[run.firstMesh], run.meshCount);
+            shader.set(decode.scale, &positionScales[run.firstMesh], run.meshCount);
+        }
+
+        for(unsigned int level = 0; level < levels; level++)
+        {
+            if(batches && (*batches)[level].instanceCount == 0)
+                continue;
+            size_t offset = (level * meshCount + run.firstMesh) * sizeof(DrawElementsIndirectCommand);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)offset, run.meshCount, 0);
+        }
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
 }
 
-unsigned int TextureFromFile(const char* str, string directory)
+void Model::loadModel(const string &path)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    
-    int width, height, nrComponents;
+    PROFILE_ZONE("Model::loadModel");
 
-    string c = directory + "/" + str;
-    const char* path = c.c_str();
+    if(takeSource(readModelSource(path)))
+        finishLoading();
+}
 
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
+bool Model::takeSource(unique_ptr<ModelSource> imported)
+{
+    // A failed import leaves an empty model, which is ready and draws nothing
+    if(!imported->valid)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
+        becomeReady();
+        return false;
+    }
+
+    source = std::move(imported);
+    meshes.reserve(source->meshes.size());
+    boundsCenter = 0.5f * (source->boundsMin + source->boundsMax);
+    boundsRadius = glm::length(source->boundsMax - boundsCenter);
+    boundsExtent = source->boundsMax - boundsCenter;
+    return true;
+}
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+void Model::uploadMesh(size_t index)
+{
+    const CachedMesh &cached = source->meshes[index];
+    vector<Texture> textures;
+    for(const CachedTexture &texture : cached.textures)
+        textures.push_back(loadTexture(texture.path.c_str(), texture.type));
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if(!keepCpuData)
+    {
+        // Straight from the mapping or the imported arrays, which go away once the model is ready
+        meshes.push_back(Mesh(cached.vertices, cached.vertexCount, cached.indices, cached.indexCount, std::move(textures), vertexFormat, cached.lods));
+        return;
+    }
 
-        stbi_image_free(data);
+    // Freshly imported arrays are handed over, mapped ones have to be copied
+    if(index < source->imported.size())
+    {
+        ImportedMesh &imported = source->imported[index];
+        meshes.push_back(Mesh(std::move(imported.vertices), std::move(imported.indices), std::move(textures), vertexFormat, cached.lods));
     }
     else
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        vector<Vertex> vertices(cached.vertices, cached.vertices + cached.vertexCount);
+        vector<unsigned int> indices(cached.indices, cached.indices + cached.indexCount);
+        meshes.push_back(Mesh(std::move(vertices), std::move(indices), std::move(textures), vertexFormat, cached.lods));
+    }
+}
+
+bool Model::continueLoading(double budgetMs)
+{
+    if(ready)
+        return true;
+
+    PROFILE_ZONE("Model::continueLoading");
+    auto start = chrono::steady_clock::now();
+    auto spentMs = [&start]() { return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count(); };
+    loadFrames++;
+
+    if(!source)
+    {
+        if(pendingSource.wait_for(chrono::seconds(0)) != future_status::ready)
+            return false;
+        if(!takeSource(pendingSource.get()))
+            return true;
+        createPlaceholder(source->boundsMin, source->boundsMax);
     }
 
-    return textureID;
+    // One mesh at a time; each acquires its textures, so their decodes start on the pool right away
+    while(uploadedMeshes < source->meshes.size() && spentMs() < budgetMs)
+        uploadMesh(uploadedMeshes++);
+    if(uploadedMeshes < source->meshes.size())
+        return false;
+
+    if(!VAO)
+    {
+        if(spentMs() >= budgetMs)
+            return false;
+        mergeMeshes();
+    }
+
+    textureCache().uploadReady(budgetMs - spentMs());
+    for(const auto &loaded : textures_loaded)
+    {
+        if(textureCache().isPending(loaded.second.id))
+            return false;
+    }
+
+    settleTextures();
+    becomeReady();
+    double totalMs = chrono::duration<double, milli>(chrono::steady_clock::now() - loadStart).count();
+    cout << "Model streamed in " << totalMs << " ms over " << loadFrames << " frames" << endl;
+    textureCache().printStats();
+    return true;
+}
+
+void Model::finishLoading()
+{
+    if(ready)
+        return;
+    if(!source && !takeSource(pendingSource.get()))
+        return;
+
+    while(uploadedMeshes < source->meshes.size())
+        uploadMesh(uploadedMeshes++);
+    uploadPendingTextures();
+    if(!VAO)
+        mergeMeshes();
+    settleTextures();
+    becomeReady();
+}
+
+void Model::becomeReady()
+{
+    // Unmaps the cache and frees the imported arrays the meshes were uploaded from
+    source.reset();
+    placeholder.reset();
+    glDeleteTextures(1, &placeholderTexture);
+    placeholderTexture = 0;
+    ready = true;
+}
+
+void Model::createPlaceholder(glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+    // Mid grey, lit like the model by the same shader
+    const unsigned char grey[4] = { 128, 128, 128, 255 };
+    glGenTextures(1, &placeholderTexture);
+    glBindTexture(GL_TEXTURE_2D, placeholderTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, 1, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+
+    // The bounding box as six quads with their own normals
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    for(int axis = 0; axis < 3; axis++)
+    {
+        for(int side = 0; side < 2; side++)
+        {
+            glm::vec3 normal(0.0f);
+            normal[axis] = side ? 1.0f : -1.0f;
+            int u = (axis + 1) % 3, v = (axis + 2) % 3;
+            unsigned int first = vertices.size();
+            for(int corner = 0; corner < 4; corner++)
+            {
+                Vertex vertex;
+                vertex.Position[axis] = side ? boundsMax[axis] : boundsMin[axis];
+                vertex.Position[u] = (corner == 1 || corner == 2) ? boundsMax[u] : boundsMin[u];
+                vertex.Position[v] = corner >= 2 ? boundsMax[v] : boundsMin[v];
+                vertex.Normal = normal;
+                vertex.TexCoords = glm::vec2(0.5f);
+                vertices.push_back(vertex);
+            }
+            unsigned int quad[6] = { 0, 1, 2, 0, 2, 3 };
+            for(unsigned int index : quad)
+                indices.push_back(first + index);
+        }
+    }
+
+    Texture texture;
+    texture.id = placeholderTexture;
+    texture.type = "texture_diffuse";
+    placeholder.reset(new Mesh(std::move(vertices), std::move(indices), vector<Texture>(1, texture), vertexFormat));
+}
+
+void Model::mergeMeshes()
+{
+    // Meshes sharing a material end up next to each other, so each run of them is one multi-draw
+    stable_sort(meshes.begin(), meshes.end(), [](const Mesh &a, const Mesh &b) { return a.materialBefore(b); });
+    groupMaterialRuns();
+
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    indexType = GL_UNSIGNED_SHORT;
+    for(const Mesh &mesh : meshes)
+    {
+        vertexCount += mesh.getVertexCount();
+        indexCount += mesh.getIndexCount();
+        // Indices are relative to each mesh's base vertex, so 16 bits only has to fit the largest mesh
+        if(mesh.getIndexType() == GL_UNSIGNED_INT)
+            indexType = GL_UNSIGNED_INT;
+    }
+    size_t stride = vertexStride(vertexFormat);
+    size_t elementSize = indexSize(indexType);
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glGenBuffers(1, &indirectBuffer);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * stride, NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * elementSize, NULL, GL_STATIC_DRAW);
+    setupVertexAttributes(vertexFormat);
+    glBindVertexArray(0);
+
+    size_t levels = 0;
+    for(const Mesh &mesh : meshes)
+        levels = max(levels, mesh.getLods().size());
+    lodErrors.assign(levels, 0.0f);
+    drawCommands.resize(levels * meshes.size());
+
+    // Copy on the GPU so both load paths merge the same way, whether or not they kept CPU copies
+    unsigned int baseVertex = 0;
+    unsigned int firstIndex = 0;
+    for(size_t i = 0; i < meshes.size(); i++)
+    {
+        Mesh &mesh = meshes[i];
+        glBindBuffer(GL_COPY_READ_BUFFER, mesh.vertexBuffer());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, baseVertex * stride, mesh.getVertexCount() * stride);
+
+        glBindBuffer(GL_COPY_READ_BUFFER, mesh.indexBuffer());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        if(mesh.getIndexType() == indexType)
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, firstIndex * elementSize, mesh.getIndexCount() * elementSize);
+        else
+        {
+            // A small mesh beside one over 64k vertices: widen its 16 bit indices on the way through
+            vector<uint16_t> shortIndices(mesh.getIndexCount());
+            glGetBufferSubData(GL_COPY_READ_BUFFER, 0, shortIndices.size() * sizeof(uint16_t), shortIndices.data());
+            vector<unsigned int> wideIndices(shortIndices.begin(), shortIndices.end());
+            glBufferSubData(GL_COPY_WRITE_BUFFER, firstIndex * elementSize, wideIndices.size() * elementSize, wideIndices.data());
+        }
+
+        // Commands are level major, so one level of every mesh is a contiguous multi-draw.
+        // A mesh with fewer levels keeps drawing its coarsest one.
+        const vector<MeshLod> &lods = mesh.getLods();
+        for(size_t level = 0; level < levels; level++)
+        {
+            const MeshLod &lod = lods[min(level, lods.size() - 1)];
+            DrawElementsIndirectCommand &command = drawCommands[level * meshes.size() + i];
+            command.count = lod.indexCount;
+            command.instanceCount = 0;
+            command.firstIndex = firstIndex + lod.firstIndex;
+            command.baseVertex = baseVertex;
+            command.baseInstance = 0;
+            lodErrors[level] = max(lodErrors[level], lod.error);
+        }
+        positionOffsets.push_back(mesh.getPositionOffset());
+        positionScales.push_back(mesh.getPositionScale());
+
+        mesh.useSharedBuffers(VAO, baseVertex, firstIndex);
+        baseVertex += mesh.getVertexCount();
+        firstIndex += mesh.getIndexCount();
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, drawCommands.size() * sizeof(DrawElementsIndirectCommand), drawCommands.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    cout << "Model geometry: " << vertexCount << " vertices x " << stride << " bytes, " << indexCount << " indices x "
+         << elementSize << " bytes (" << (vertexCount * stride + indexCount * elementSize) / 1024.0 << " KiB)" << endl;
+}
+
+void Model::groupMaterialRuns()
+{
+    materialRuns.clear();
+    for(unsigned int i = 0; i < meshes.size(); i++)
+    {
+        if(!materialRuns.empty() && materialRuns.back().meshCount < MAX_MULTI_DRAW_MESHES && meshes[materialRuns.back().firstMesh].sameMaterial(meshes[i]))
+            materialRuns.back().meshCount++;
+        else
+            materialRuns.push_back({ i, 1 });
+    }
+}
+
+// Sorts the merged meshes by material again once their textures changed, carrying each mesh's
+// commands and position decode along, and regroups the runs
+void Model::orderByMaterial()
+{
+    size_t meshCount = meshes.size();
+    vector<unsigned int> order(meshCount);
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b) { return meshes[a].materialBefore(meshes[b]); });
+
+    vector<Mesh> sortedMeshes;
+    sortedMeshes.reserve(meshCount);
+    vector<DrawElementsIndirectCommand> sortedCommands(drawCommands.size());
+    vector<glm::vec3> sortedOffsets, sortedScales;
+    for(size_t i = 0; i < meshCount; i++)
+    {
+        sortedMeshes.push_back(std::move(meshes[order[i]]));
+        sortedOffsets.push_back(positionOffsets[order[i]]);
+        sortedScales.push_back(positionScales[order[i]]);
+        for(size_t level = 0; level < lodErrors.size(); level++)
+            sortedCommands[level * meshCount + i] = drawCommands[level * meshCount + order[i]];
+    }
+    meshes.swap(sortedMeshes);
+    drawCommands.swap(sortedCommands);
+    positionOffsets.swap(sortedOffsets);
+    positionScales.swap(sortedScales);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, drawCommands.size() * sizeof(DrawElementsIndirectCommand), drawCommands.data());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    groupMaterialRuns();
+}
+
+// Once every texture has decoded: a texture that turned out to hold the same image as one
+// acquired under another path is swapped for that one in the meshes, and the meshes are
+// sorted again so the ones now sharing a material merge into one run
+void Model::settleTextures()
+{
+    bool changed = false;
+    for(auto &loaded : textures_loaded)
+    {
+        unsigned int id = textureCache().settle(loaded.second.id);
+        if(id == loaded.second.id)
+            continue;
+        for(Mesh &mesh : meshes)
+            mesh.replaceTexture(loaded.second.id, id);
+        loaded.second.id = id;
+        changed = true;
+    }
+    if(changed)
+        orderByMaterial();
+}
+
+Texture Model::loadTexture(const char *path, const string &typeName)
+{
+    string key = typeName + ":" + path;
+    auto loaded = textures_loaded.find(key);
+    if(loaded != textures_loaded.end())
+        return loaded->second;
+
+    // One reference per distinct type and path in this model. A texture new to the process is
+    // decoded in parallel and uploaded in uploadPendingTextures (or bit by bit from
+    // continueLoading), one another model loaded is reused as is. Only diffuse maps hold color;
+    // specular maps are filtered as the values they store.
+    TextureContent content = typeName == "texture_diffuse" ? TEXTURE_CONTENT_COLOR : TEXTURE_CONTENT_DATA;
+    Texture texture;
+    texture.id = textureCache().acquire(directory + "/" + path, content);
+    texture.type = typeName;
+    texture.path = path;
+
+    textures_loaded.emplace(key, texture);
+    return texture;
+}
+
+void Model::uploadPendingTextures()
+{
+    if(textures_loaded.empty())
+        return;
+
+    auto start = chrono::steady_clock::now();
+    unsigned int uploaded = textureCache().uploadPending();
+
+    double totalMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "Loaded " << uploaded << " new of " << textures_loaded.size() << " model textures in " << totalMs << " ms" << endl;
+    textureCache().printStats();
 }
@@ -4,24 +4,135 @@
 #include <assimp/scene.h>
 
 #include "../shader/shader.hpp"
+#include "../texture/texture_cache.hpp"
 #include "mesh.h"
 
+#include <chrono>
+#include <future>
+#include <memory>
+#include <unordered_map>
+
+// Layout of one glMultiDrawElementsIndirect command, as defined by OpenGL
+struct DrawElementsIndirectCommand
+{
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    unsigned int baseInstance;
+};
+
+// The instances drawing one level of detail: a range of the instance order buffer that the
+// vertex shader reads at gl_BaseInstance (see src/lod/lod_selector.hpp)
+struct LodBatch
+{
+    unsigned int firstInstance;
+    unsigned int instanceCount;
+};
+
+// MODEL_LOAD_BLOCKING returns from the constructor with the model ready to draw.
+// MODEL_LOAD_ASYNC returns at once: the import runs on the worker pool and the GL work is
+// done a slice per frame by continueLoading, with Draw showing a placeholder until then.
+enum ModelLoadMode
+{
+    MODEL_LOAD_BLOCKING,
+    MODEL_LOAD_ASYNC
+};
+
+// Geometry and texture references read off the GL thread (defined in model.cpp)
+struct ModelSource;
+
 class Model 
 {
     public:
-        Model(char* path);
+        // keepCpuData leaves each mesh's vertices and indices in memory after upload, for
+        // callers such as picking or collision; otherwise only the GPU copy remains
+        Model(const string &path, VertexFormat format = VERTEX_FORMAT_FLOAT, bool keepCpuData = false, ModelLoadMode loadMode = MODEL_LOAD_BLOCKING);
+        ~Model();
+        Model(const Model&) = delete;
+        Model& operator=(const Model&) = delete;
+
+        // Draws batches[level] of the instances at each level of detail, every instance once
+        // per view (2 for single pass stereo). Until the model is ready this draws a grey box
+        // over its bounds, or nothing before the import has finished.
+        void Draw(Shader &shader, const vector<LodBatch> &batches, unsigned int viewCount = 1);
+        // Draws every level with the instance counts a compute pass wrote into the indirect
+        // buffer (see src/cull/gpu_culler.hpp). Only once the model is ready.
+        void DrawGenerated(Shader &shader);
 
-        void Draw(Shader &shader);
+        bool isReady() const { return ready; }
+        // GL thread, once per frame while streaming: uploads meshes, then the textures that
+        // have finished decoding, for about budgetMs. Returns isReady().
+        bool continueLoading(double budgetMs);
+        // Blocks until the model is ready, e.g. before a benchmark starts timing
+        void finishLoading();
+
+        // Levels of detail across all meshes, 1 until the model is ready
+        unsigned int getLodCount() const { return lodErrors.empty() ? 1 : lodErrors.size(); }
+        // Largest object space error of any mesh at the level, never less than the level above
+        float getLodError(unsigned int level) const { return level < lodErrors.size() ? lodErrors[level] : 0.0f; }
+        // Bounding sphere in object space, known once the import has finished
+        glm::vec3 getBoundsCenter() const { return boundsCenter; }
+        float getBoundsRadius() const { return boundsRadius; }
+        // Half the size of the object space bounding box around getBoundsCenter()
+        glm::vec3 getBoundsExtent() const { return boundsExtent; }
+        unsigned int getMeshCount() const { return meshes.size(); }
+        // Indirect commands at [level * getMeshCount() + mesh], for passes that write them on the GPU
+        unsigned int getIndirectBuffer() const { return indirectBuffer; }
 
     private:
         vector<Mesh> meshes;
-        vector<Texture> textures_loaded;
+        // One cache reference per distinct texture type and path the materials name, keyed
+        // "type:path" since a diffuse and a specular use of one image are filtered apart
+        unordered_map<string, Texture> textures_loaded;
         string directory;
+        VertexFormat vertexFormat;
+        bool keepCpuData;
+
+        // Streaming state: the import on the worker pool, then its result while the meshes are
+        // uploaded one by one; both are gone once the model is ready
+        future<unique_ptr<ModelSource>> pendingSource;
+        unique_ptr<ModelSource> source;
+        size_t uploadedMeshes = 0;
+        bool ready = false;
+        unique_ptr<Mesh> placeholder;
+        unsigned int placeholderTexture = 0;
+        chrono::steady_clock::time_point loadStart;
+        unsigned int loadFrames = 0;
+
+        // Every mesh packed into one vertex and index buffer, one indirect command per mesh
+        // and level at drawCommands[level * meshes.size() + mesh]
+        unsigned int VAO = 0, VBO = 0, EBO = 0, indirectBuffer = 0;
+        GLenum indexType;
+        vector<DrawElementsIndirectCommand> drawCommands;
+        vector<float> lodErrors;
+        // Set once the GPU has written the commands, so the CPU copy is no longer what they hold
+        bool commandsWrittenOnGpu = false;
+        // Meshes drawn by one multi-draw: consecutive, sharing a material, at most MAX_MULTI_DRAW_MESHES
+        struct MaterialRun
+        {
+            unsigned int firstMesh;
+            unsigned int meshCount;
+        };
+        vector<MaterialRun> materialRuns;
+        // Per mesh position decode for compact vertices, uploaded per run
+        vector<glm::vec3> positionOffsets, positionScales;
+        glm::vec3 boundsCenter = glm::vec3(0.0f);
+        float boundsRadius = 0.0f;
+        glm::vec3 boundsExtent = glm::vec3(0.0f);
 
-        void loadModel(string path);
-        void processNode(aiNode *node, const aiScene *scene);
-        Mesh processMesh(aiMesh *mesh, const aiScene *scene);
-        vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName);
+        void loadModel(const string &path);
+        bool takeSource(unique_ptr<ModelSource> imported);
+        void uploadMesh(size_t index);
+        Texture loadTexture(const char *path, const string &typeName);
+        void uploadPendingTextures();
+        void mergeMeshes();
+        void groupMaterialRuns();
+        void orderByMaterial();
+        void settleTextures();
+        void drawLevels(const Shader &shader, unsigned int levels, const vector<LodBatch> *batches);
+        void createPlaceholder(glm::vec3 boundsMin, glm::vec3 boundsMax);
+        void becomeReady();
 };
 
 #endif
@@ -0,0 +1,308 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include "options.hpp"
+
+static void printUsage(const char* program)
+{
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --fish <count>               number of fish instances to draw (default 1)\n"
+              << "  --stereo <mode>              two-pass (default) or single-pass layered rendering\n"
+              << "  --eye <width>x<height>       per-eye render resolution (default 800x600)\n"
+              << "  --compact-vertices           quantized 16 byte vertices instead of 32 bytes of floats\n"
+              << "  --texture-compression <mode> bc (default, BC1 or BC3 with alpha), bc7, or none for raw RGBA\n"
+              << "  --mip-filter <filter>        kaiser (default) or box, applied in linear light to build every mip level\n"
+              << "  --stream-budget <ms>         GL time per frame spent uploading the model while it streams in (default 2)\n"
+              << "  --lod-error <pixels>         screen space error allowed when picking each fish's level of detail (default 1, 0 for full detail)\n"
+              << "  --lod-hysteresis <fraction>  how far past the error threshold a fish has to get before it switches level (default 0.2)\n"
+              << "  --culling <mode>             cpu (default), gpu (compute pass writing the indirect draws), or none\n"
+              << "  --occlusion <mode>           off (default), per-eye or shared: also cull fish hidden in last frame's depth (needs --culling gpu)\n"
+              << "  --warmup                     draw every program once at startup so the first frame does not stall\n"
+              << "  --headless                   render offscreen through EGL without a window, then print timings\n"
+              << "  --frames <count>             frames to render headless, or per benchmark run (default 300)\n"
+              << "  --record-camera-path <file>  write the interactive camera path for benchmark replays\n"
+              << "  --trace <file>               record CPU profiler zones from startup and write a Chrome trace on exit\n"
+              << "                               (P pauses and resumes recording in the window)\n"
+              << "\n"
+              << "Benchmark (headless, one run per combination of the lists):\n"
+              << "  --benchmark                  replay a camera path and report frame time percentiles\n"
+              << "  --camera-path <file>         recorded path to replay (default: built-in scripted path)\n"
+              << "  --bench-fish <list>          comma separated fish counts, e.g. 1,64,512\n"
+              << "  --bench-eye <list>           comma separated eye resolutions, e.g. 800x600,1440x1600\n"
+              << "  --bench-stereo <list>        comma separated stereo modes, e.g. two-pass,single-pass\n"
+              << "  --bench-json <file>          write results as JSON\n"
+              << "  --bench-csv <file>           write results as CSV\n";
+}
+
+static bool parseUnsigned(const char* text, unsigned int& value)
+{
+    char* end = nullptr;
+    unsigned long parsed = std::strtoul(text, &end, 10);
+    if (end == text || *end != '\0' || parsed == 0)
+        return false;
+
+    value = static_cast<unsigned int>(parsed);
+    return true;
+}
+
+// Any finite number not below zero
+static bool parseNonNegative(const char* text, float& value)
+{
+    char* end = nullptr;
+    float parsed = std::strtof(text, &end);
+    if (end == text || *end != '\0' || !(parsed >= 0.0f) || parsed == HUGE_VALF)
+        return false;
+
+    value = parsed;
+    return true;
+}
+
+static bool parseStereoMode(const std::string& text, StereoMode& mode)
+{
+    if (text == "two-pass")
+        mode = STEREO_TWO_PASS;
+    else if (text == "single-pass")
+        mode = STEREO_SINGLE_PASS;
+    else
+        return false;
+    return true;
+}
+
+static bool parseCullingMode(const std::string& text, CullingMode& mode)
+{
+    if (text == "none")
+        mode = CULLING_NONE;
+    else if (text == "cpu")
+        mode = CULLING_CPU;
+    else if (text == "gpu")
+        mode = CULLING_GPU;
+    else
+        return false;
+    return true;
+}
+
+static bool parseOcclusionMode(const std::string& text, OcclusionMode& mode)
+{
+    if (text == "off")
+        mode = OCCLUSION_OFF;
+    else if (text == "per-eye")
+        mode = OCCLUSION_PER_EYE;
+    else if (text == "shared")
+        mode = OCCLUSION_SHARED;
+    else
+        return false;
+    return true;
+}
+
+static bool parseTextureCompression(const std::string& text, TextureCompression& compression)
+{
+    if (text == "none")
+        compression = TEXTURE_COMPRESSION_NONE;
+    else if (text == "bc")
+        compression = TEXTURE_COMPRESSION_BC;
+    else if (text == "bc7")
+        compression = TEXTURE_COMPRESSION_BC7;
+    else
+        return false;
+    return true;
+}
+
+static bool parseMipFilter(const std::string& text, MipFilter& filter)
+{
+    if (text == "kaiser")
+        filter = MIP_FILTER_KAISER;
+    else if (text == "box")
+        filter = MIP_FILTER_BOX;
+    else
+        return false;
+    return true;
+}
+
+static bool parseResolution(const std::string& text, EyeResolution& resolution)
+{
+    char trailing;
+    return std::sscanf(text.c_str(), "%ux%u%c", &resolution.width, &resolution.height, &trailing) == 2
+        && resolution.width > 0 && resolution.height > 0;
+}
+
+// Splits a comma separated list and parses every item, false if any item is invalid
+template<typename T, typename Parse>
+static bool parseList(const char* text, std::vector<T>& values, Parse parse)
+{
+    values.clear();
+    std::istringstream items(text);
+    std::string item;
+    while (std::getline(items, item, ','))
+    {
+        T value;
+        if (!parse(item, value))
+            return false;
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (std::strcmp(arg, "--fish") == 0 && hasValue)
+        {
+            if (!parseUnsigned(argv[++i], options.fishCount))
+            {
+                std::cout << "ERROR::OPTIONS::INVALID_FISH_COUNT " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--stereo") == 0 && hasValue)
+        {
+            const char* mode = argv[++i];
+            if (!parseStereoMode(mode, options.stereoMode))
+            {
+                std::cout << "ERROR::OPTIONS::INVALID_STEREO_MODE " << mode << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--eye") == 0 && hasValue)
+        {
+            if (!parseResolution(argv[++i], options.eyeResolution))
+            {
+                std::cout << "ERROR::OPTIONS::INVALID_EYE_RESOLUTION " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--compact-vertices") == 0)
+            options.compactVertices = true;
+        else if (std::strcmp(arg, "--texture-compression") == 0 && hasValue)
+        {
+            const char* mode = argv[++i];
+            if (!parseTextureCompression(mode, options.textureCompression))
+            {
+                std::cout << "ERROR::OPTIONS::INVALID_TEXTURE_COMPRESSION " << mode << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--mip-filter") == 0 && hasValue)
+        {
+            const char* filter = argv[++i];
+            if (!parseMipFilter(filter, options.mipFilter))
+            {
+                std::cout << "ERROR::OPTIONS::INVALID_MIP_FILTER " << filter << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--stream-budget") == 0 && hasValue)
+        {
+            char* end = nullptr;
+            options.streamBudgetMs = std::strtod(argv[++i], &end);
+            if (end == argv[i] || *end != '\0' || options.streamBudgetMs <= 0.0)
+            {
+                std::cout << "ERROR::OPTIONS::INVALID_STREAM_BUDGET " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--lod-error") == 0 && hasValue)
+        {
+            if (!parseNonNegative(argv[++i], options.lodErrorPixels))
+            {
+                std::cout << "ERROR::OPTIONS::INVALID_LOD_ERROR " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--lod-hysteresis") == 0 && hasValue)
+        {
+            if (!parseNonNegative(argv[++i], options.lodHysteresis) || options.lodHysteresis >= 1.0f)
+            {
+                std::cout << "ERROR::OPTIONS::INVALID_LOD_HYSTERESIS " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--culling") == 0 && hasValue)
+        {
+            const char* mode = argv[++i];
+            if (!parseCullingMode(mode, options.culling))
+            {
+                std::cout << "ERROR::OPTIONS::INVALID_CULLING_MODE " << mode << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--occlusion") == 0 && hasValue)
+        {
+            const char* mode = argv[++i];
+            if (!parseOcclusionMode(mode, options.occlusion))
+            {
+                std::cout << "ERROR::OPTIONS::INVALID_OCCLUSION_MODE " << mode << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--warmup") == 0)
+            options.warmUp = true;
+        else if (std::strcmp(arg, "--headless") == 0)
+            options.headless = true;
+        else if (std::strcmp(arg, "--frames") == 0 && hasValue)
+        {
+            if (!parseUnsigned(argv[++i], options.frames))
+            {
+                std::cout << "ERROR::OPTIONS::INVALID_FRAME_COUNT " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--record-camera-path") == 0 && hasValue)
+            options.recordCameraPath = argv[++i];
+        else if (std::strcmp(arg, "--trace") == 0 && hasValue)
+            options.tracePath = argv[++i];
+        else if (std::strcmp(arg, "--benchmark") == 0)
+            options.benchmark = true;
+        else if (std::strcmp(arg, "--camera-path") == 0 && hasValue)
+            options.cameraPath = argv[++i];
+        else if (std::strcmp(arg, "--bench-fish") == 0 && hasValue)
+        {
+            auto parseCount = [](const std::string& item, unsigned int& value) { return parseUnsigned(item.c_str(), value); };
+            if (!parseList(argv[++i], options.benchFishCounts, parseCount))
+            {
+                std::cout << "ERROR::OPTIONS::INVALID_FISH_COUNT " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--bench-eye") == 0 && hasValue)
+        {
+            if (!parseList(argv[++i], options.benchResolutions, parseResolution))
+            {
+                std::cout << "ERROR::OPTIONS::INVALID_EYE_RESOLUTION " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--bench-stereo") == 0 && hasValue)
+        {
+            if (!parseList(argv[++i], options.benchStereoModes, parseStereoMode))
+            {
+                std::cout << "ERROR::OPTIONS::INVALID_STEREO_MODE " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--bench-json") == 0 && hasValue)
+            options.benchJson = argv[++i];
+        else if (std::strcmp(arg, "--bench-csv") == 0 && hasValue)
+            options.benchCsv = argv[++i];
+        else
+        {
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+
+    if (options.occlusion != OCCLUSION_OFF && options.culling != CULLING_GPU)
+    {
+        std::cout << "ERROR::OPTIONS::OCCLUSION_NEEDS_GPU_CULLING" << std::endl;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,82 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <string>
+#include <vector>
+
+#include "../texture/texture_compression.hpp"
+
+enum StereoMode
+{
+    STEREO_TWO_PASS,
+    STEREO_SINGLE_PASS
+};
+
+// Where fish outside both eyes' view are dropped, and their levels of detail picked
+enum CullingMode
+{
+    CULLING_NONE,
+    CULLING_CPU,
+    CULLING_GPU
+};
+
+// Whether fish hidden behind what the previous frame drew are dropped too, tested in each eye
+// or once for both against the farther of their depths
+enum OcclusionMode
+{
+    OCCLUSION_OFF,
+    OCCLUSION_PER_EYE,
+    OCCLUSION_SHARED
+};
+
+struct EyeResolution
+{
+    unsigned int width;
+    unsigned int height;
+};
+
+struct Options
+{
+    unsigned int fishCount = 1;
+    StereoMode stereoMode = STEREO_TWO_PASS;
+    EyeResolution eyeResolution = { 800, 600 };
+    bool warmUp = false;
+    // Upload meshes as 16 byte quantized vertices instead of 32 bytes of floats
+    bool compactVertices = false;
+    // Block compressed textures, cached next to each image after the first encode
+    TextureCompression textureCompression = TEXTURE_COMPRESSION_BC;
+    MipFilter mipFilter = MIP_FILTER_KAISER;
+    // The model loads in the background; each frame gives its GL uploads this long
+    double streamBudgetMs = 2.0;
+    // Each fish draws the coarsest level of detail whose error stays under this many pixels,
+    // switching only once it is lodHysteresis (a fraction of the threshold) past it
+    float lodErrorPixels = 1.0f;
+    float lodHysteresis = 0.2f;
+    // Skip fish whose bounds are outside both eyes' view before anything is drawn
+    CullingMode culling = CULLING_CPU;
+    // Needs culling on the GPU, where the depth pyramid is tested
+    OcclusionMode occlusion = OCCLUSION_OFF;
+    bool headless = false;
+    // Frames rendered before a headless run exits, and per configuration when benchmarking
+    unsigned int frames = 300;
+
+    // Benchmark mode: replays a camera path headless for every combination of the lists below
+    bool benchmark = false;
+    std::vector<unsigned int> benchFishCounts;
+    std::vector<EyeResolution> benchResolutions;
+    std::vector<StereoMode> benchStereoModes;
+    std::string cameraPath;
+    std::string benchJson;
+    std::string benchCsv;
+
+    // Interactive sessions write their camera path here for later benchmark replays
+    std::string recordCameraPath;
+
+    // Chrome trace of the CPU profiler zones, written on exit; empty leaves the profiler off
+    std::string tracePath;
+};
+
+// Parses command line flags into options. Returns false (after printing usage) on bad input.
+bool parseOptions(int argc, char** argv, Options& options);
+
+#endif
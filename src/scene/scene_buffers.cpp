@@ -0,0 +1,65 @@
+#include <vector>
+
+#include "scene_buffers.hpp"
+
+static unsigned int createUniformBuffer(size_t size, const void* data)
+{
+    unsigned int ubo;
+    glGenBuffers(1, &ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, size, data, data ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    return ubo;
+}
+
+SceneBuffers::SceneBuffers()
+{
+    cameraUBO = createUniformBuffer(sizeof(StereoCameraBlock), NULL);
+    frameUBO = createUniformBuffer(sizeof(FrameBlock), NULL);
+    lightUBO = createUniformBuffer(sizeof(LightBlock), NULL);
+
+    // Nothing else uses these binding points, so they stay bound for the whole run
+    glBindBufferBase(GL_UNIFORM_BUFFER, STEREO_CAMERA_BINDING, cameraUBO);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BINDING, frameUBO);
+    glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BINDING, lightUBO);
+
+    // One eye index per aligned slot; two pass rendering rebinds the range instead of
+    // touching any program state between eyes.
+    int alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    eyeSelectStride = alignment > 16 ? alignment : 16;
+
+    std::vector<int> slots(eyeSelectStride / sizeof(int) * 2, 0);
+    slots[eyeSelectStride / sizeof(int)] = RIGHT_EYE;
+    eyeSelectUBO = createUniformBuffer(slots.size() * sizeof(int), slots.data());
+    bindEye(LEFT_EYE);
+}
+
+void SceneBuffers::updateCamera(const StereoCameraBlock& camera)
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, cameraUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(StereoCameraBlock), &camera);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void SceneBuffers::updateFrame(float time)
+{
+    FrameBlock frame = {};
+    frame.time = time;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameBlock), &frame);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void SceneBuffers::setLight(const LightBlock& light)
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, lightUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightBlock), &light);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void SceneBuffers::bindEye(EyeIndex eye) const
+{
+    glBindBufferRange(GL_UNIFORM_BUFFER, EYE_SELECT_BINDING, eyeSelectUBO, eye * eyeSelectStride, sizeof(int) * 4);
+}
@@ -0,0 +1,60 @@
+#ifndef SCENE_BUFFERS_H
+#define SCENE_BUFFERS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "../stereo/eye_target.hpp"
+
+// Uniform block binding points shared by every program. Each block is declared with the
+// same std140 layout in the shaders that read it.
+const unsigned int STEREO_CAMERA_BINDING = 0;
+const unsigned int FRAME_BINDING = 1;
+const unsigned int LIGHT_BINDING = 2;
+const unsigned int EYE_SELECT_BINDING = 3;
+
+// Both eyes, written once per frame. Single pass picks the eye from the instance ID,
+// two pass from the EyeSelect block.
+struct StereoCameraBlock
+{
+    glm::mat4 views[2];
+    glm::mat4 projections[2];
+    glm::mat4 skyViews[2];
+};
+
+struct FrameBlock
+{
+    float time;
+    float padding[3];
+};
+
+// vec3 members are stored as vec4 so the C++ layout matches std140 without manual padding.
+struct LightBlock
+{
+    glm::vec4 position;
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+};
+
+class SceneBuffers
+{
+public:
+    SceneBuffers();
+
+    void updateCamera(const StereoCameraBlock& camera);
+    void updateFrame(float time);
+    void setLight(const LightBlock& light);
+
+    // Points the EyeSelect block at the range holding this eye's index.
+    void bindEye(EyeIndex eye) const;
+
+private:
+    unsigned int cameraUBO;
+    unsigned int frameUBO;
+    unsigned int lightUBO;
+    unsigned int eyeSelectUBO;
+    int eyeSelectStride;
+};
+
+#endif
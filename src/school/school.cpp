@@ -0,0 +1,61 @@
+#include <cmath>
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "school.hpp"
+
+// Average distance between neighbouring fish; the tank grows with the school to keep this.
+const float FISH_SPACING = 6.0f;
+
+FishSchool::FishSchool(unsigned int count)
+{
+    std::mt19937 rng(1337);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // Tank in front of the starting camera, twice as deep and half as tall as it is wide.
+    float side = FISH_SPACING * std::cbrt(static_cast<float>(count));
+    glm::vec3 tankMin(-0.5f * side, -0.25f * side, -4.0f - 2.0f * side);
+    glm::vec3 tankMax( 0.5f * side,  0.25f * side, -4.0f);
+
+    instances.resize(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        glm::vec3 position;
+        float yaw = 0.0f;
+
+        if (i == 0)
+            position = glm::vec3(1.0f, 1.0f, -7.0f);
+        else
+        {
+            position = tankMin + (tankMax - tankMin) * glm::vec3(unit(rng), unit(rng), unit(rng));
+            yaw = glm::radians(360.0f * unit(rng));
+        }
+
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+        model = glm::rotate(model, yaw, glm::vec3(0.0f, 1.0f, 0.0f));
+
+        instances[i].model = model;
+        instances[i].params = glm::vec4(i == 0 ? 0.0f : 6.2831853f * unit(rng), 0.0f, 0.0f, 0.0f);
+    }
+
+    glGenBuffers(1, &SSBO);
+    upload();
+}
+
+FishSchool::~FishSchool()
+{
+    glDeleteBuffers(1, &SSBO);
+}
+
+void FishSchool::upload()
+{
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instances.size() * sizeof(FishInstance), instances.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void FishSchool::bind() const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, SSBO);
+}
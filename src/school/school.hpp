@@ -0,0 +1,41 @@
+#ifndef SCHOOL_H
+#define SCHOOL_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Matches the std430 FishInstance struct in shaders/shader.vert.glsl.
+struct FishInstance
+{
+    glm::mat4 model;
+    // x: animation phase, yzw: unused
+    glm::vec4 params;
+};
+
+const unsigned int INSTANCE_BINDING = 0;
+
+// Furthest the swim animation in shaders/shader.vert.glsl moves a vertex from where the
+// model puts it, in object space: the body wave plus the side to side stride
+const float FISH_SWIM_AMPLITUDE = 0.07f + 0.15f;
+
+class FishSchool
+{
+public:
+    std::vector<FishInstance> instances;
+
+    FishSchool(unsigned int count);
+    ~FishSchool();
+    FishSchool(const FishSchool&) = delete;
+    FishSchool& operator=(const FishSchool&) = delete;
+
+    void upload();
+    void bind() const;
+    unsigned int count() const { return static_cast<unsigned int>(instances.size()); }
+
+private:
+    unsigned int SSBO;
+};
+
+#endif
@@ -1,44 +1,216 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <glm/ext/matrix_float4x4.hpp>
 #include <sstream>
 #include <iostream>
+#include <vector>
+
+#include <sys/stat.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "shader.hpp"
+#include "../util/profiler.hpp"
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
+static void insertDefines(std::string& code, const std::string& defines)
 {
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
+    if (defines.empty())
+        return;
 
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    size_t lineEnd = code.rfind("#version", 0) == 0 ? code.find('\n') : std::string::npos;
+    if (lineEnd == std::string::npos)
+        code.insert(0, defines);
+    else
+        code.insert(lineEnd + 1, defines);
+}
 
-    try 
+// The shaders target GLSL 4.60. On a 4.5 context (e.g. Mesa llvmpipe) they are compiled as
+// 4.50, with the draw parameters they use taken from ARB_shader_draw_parameters instead.
+static void matchContextVersion(std::string& code)
+{
+    if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 6))
+        return;
+
+    const std::string version = "#version 460 core";
+    if (code.rfind(version, 0) != 0)
+        return;
+
+    std::string patch = "#version 450 core\n";
+    if (code.find("gl_DrawID") != std::string::npos || code.find("gl_BaseInstance") != std::string::npos)
+        patch += "#extension GL_ARB_shader_draw_parameters : require\n"
+                 "#define gl_DrawID gl_DrawIDARB\n"
+                 "#define gl_BaseInstance gl_BaseInstanceARB\n";
+    code.replace(0, code.find('\n') + 1, patch);
+}
+
+// Program binaries are cached per source and driver; a driver update invalidates them through the key.
+static const char* PROGRAM_CACHE_DIR = "shader_cache";
+static const char PROGRAM_CACHE_MAGIC[8] = { 'G', 'L', 'P', 'R', 'O', 'G', 'B', 'N' };
+static const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t format;
+    uint64_t key;
+    uint64_t length;
+};
+
+static uint64_t fnv1a(uint64_t hash, const char* data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
     {
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint64_t programCacheKey(const std::string& vertexCode, const std::string& fragmentCode)
+{
+    const char* driver[] = {
+        (const char*)glGetString(GL_VENDOR),
+        (const char*)glGetString(GL_RENDERER),
+        (const char*)glGetString(GL_VERSION)
+    };
 
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();	
+    uint64_t hash = 14695981039346656037ull;
+    hash = fnv1a(hash, vertexCode.c_str(), vertexCode.size() + 1);
+    hash = fnv1a(hash, fragmentCode.c_str(), fragmentCode.size() + 1);
+    for (const char* text : driver)
+        hash = text ? fnv1a(hash, text, std::strlen(text) + 1) : hash;
+    return hash;
+}
+
+static std::string programCachePath(uint64_t key)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+    return PROGRAM_CACHE_DIR + std::string(name);
+}
+
+static bool programBinariesSupported()
+{
+    int formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+// Returns a linked program from the cache, or 0 when missing or rejected by the driver.
+static unsigned int loadProgramBinary(uint64_t key)
+{
+    std::ifstream file(programCachePath(key), std::ios::binary);
+    if (!file)
+        return 0;
+
+    ProgramCacheHeader header;
+    if (!file.read((char*)&header, sizeof(header))
+        || std::memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != PROGRAM_CACHE_VERSION || header.key != key)
+        return 0;
 
-        vShaderFile.close();
-        fShaderFile.close();
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), binary.size()))
+        return 0;
 
-        vertexCode   = vShaderStream.str();
-        fragmentCode = fShaderStream.str();		
+    unsigned int program = glCreateProgram();
+    glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        std::cout << "Program binary " << programCachePath(key) << " rejected by the driver, recompiling" << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+static void saveProgramBinary(unsigned int program, uint64_t key)
+{
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    ProgramCacheHeader header;
+    std::memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+    header.version = PROGRAM_CACHE_VERSION;
+    header.key = key;
+
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+    header.format = format;
+    header.length = length;
+
+    mkdir(PROGRAM_CACHE_DIR, 0755);
+    std::string path = programCachePath(key);
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        file.write((const char*)&header, sizeof(header));
+        file.write(binary.data(), length);
+        if (!file)
+        {
+            std::cout << "ERROR::SHADER::PROGRAM_CACHE_WRITE_FAILED " << path << std::endl;
+            return;
+        }
+    }
+    std::rename(temporary.c_str(), path.c_str());
+}
+
+static std::string readShaderSource(const char* path)
+{
+    std::ifstream file;
+    file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+    try 
+    {
+        file.open(path);
+        std::stringstream stream;
+        stream << file.rdbuf();
+        file.close();
+        return stream.str();
     }
 
     catch(std::ifstream::failure e)
     {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
     }
+    return std::string();
+}
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines)
+{
+    PROFILE_ZONE("Shader::Shader");
+    auto start = std::chrono::steady_clock::now();
+
+    std::string vertexCode = readShaderSource(vertexPath);
+    std::string fragmentCode = readShaderSource(fragmentPath);
+
+    insertDefines(vertexCode, defines);
+    insertDefines(fragmentCode, defines);
+    matchContextVersion(vertexCode);
+    matchContextVersion(fragmentCode);
+
+    bool cacheable = programBinariesSupported();
+    uint64_t key = programCacheKey(vertexCode, fragmentCode);
+    ID = cacheable ? loadProgramBinary(key) : 0;
+    if (ID)
+    {
+        reflectUniforms();
+        double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Shader " << vertexPath << ": program binary cache hit (" << loadMs << " ms)" << std::endl;
+        return;
+    }
 
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
@@ -72,6 +244,8 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
     ID = glCreateProgram();
     glAttachShader(ID, vertex);
     glAttachShader(ID, fragment);
+    if (cacheable)
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(ID);
 
     glGetProgramiv(ID, GL_LINK_STATUS, &success);
@@ -80,9 +254,130 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
         glGetProgramInfoLog(ID, 512, NULL, infoLog);
         std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
     }
+    else
+    {
+        reflectUniforms();
+        if (cacheable)
+            saveProgramBinary(ID, key);
+    }
   
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+
+    double compileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Shader " << vertexPath << ": compiled from source (" << compileMs << " ms)" << std::endl;
+}
+
+Shader Shader::compute(const char* computePath, const std::string& defines)
+{
+    PROFILE_ZONE("Shader::compute");
+    auto start = std::chrono::steady_clock::now();
+    Shader shader;
+    unsigned int& ID = shader.ID;
+
+    std::string computeCode = readShaderSource(computePath);
+    insertDefines(computeCode, defines);
+    matchContextVersion(computeCode);
+
+    bool cacheable = programBinariesSupported();
+    uint64_t key = programCacheKey(computeCode, "");
+    ID = cacheable ? loadProgramBinary(key) : 0;
+    if (ID)
+    {
+        shader.reflectUniforms();
+        double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Shader " << computePath << ": program binary cache hit (" << loadMs << " ms)" << std::endl;
+        return shader;
+    }
+
+    const char* cShaderCode = computeCode.c_str();
+    int success;
+    char infoLog[512];
+
+    unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(compute, 1, &cShaderCode, NULL);
+    glCompileShader(compute);
+
+    glGetShaderiv(compute, GL_COMPILE_STATUS, &success);
+    if(!success)
+    {
+        glGetShaderInfoLog(compute, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" << infoLog << std::endl;
+    }
+
+    ID = glCreateProgram();
+    glAttachShader(ID, compute);
+    if (cacheable)
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(ID);
+
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    if(!success)
+    {
+        glGetProgramInfoLog(ID, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    }
+    else
+    {
+        shader.reflectUniforms();
+        if (cacheable)
+            saveProgramBinary(ID, key);
+    }
+
+    glDeleteShader(compute);
+
+    double compileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Shader " << computePath << ": compiled from source (" << compileMs << " ms)" << std::endl;
+    return shader;
+}
+
+void Shader::warmUp()
+{
+    // Attribute-less draw: every vertex reads the same default attribute values, so the
+    // triangle is degenerate and touches no pixels, but the driver still has to finish
+    // building the pipeline for the currently bound framebuffer and state.
+    static unsigned int emptyVAO = 0;
+    if (!emptyVAO)
+        glGenVertexArrays(1, &emptyVAO);
+
+    use();
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+}
+
+void Shader::reflectUniforms()
+{
+    int count = 0;
+    glGetProgramInterfaceiv(ID, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+
+    const GLenum properties[] = { GL_NAME_LENGTH, GL_LOCATION, GL_ARRAY_SIZE };
+    std::string name;
+
+    for (int i = 0; i < count; i++)
+    {
+        int values[3];
+        glGetProgramResourceiv(ID, GL_UNIFORM, i, 3, properties, 3, NULL, values);
+
+        // Members of uniform blocks have no location
+        int location = values[1];
+        if (location < 0)
+            continue;
+
+        name.resize(values[0]);
+        glGetProgramResourceName(ID, GL_UNIFORM, i, values[0], NULL, &name[0]);
+        name.resize(values[0] - 1);
+        uniformLocations[name] = location;
+
+        // Arrays are reported as "name[0]"; register the bare name and every element too
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+        {
+            std::string base = name.substr(0, name.size() - 3);
+            uniformLocations[base] = location;
+            for (int element = 1; element < values[2]; element++)
+                uniformLocations[base + "[" + std::to_string(element) + "]"] = location + element;
+        }
+    }
 }
 
 void Shader::use() 
@@ -90,32 +385,78 @@ void Shader::use()
     glUseProgram(ID);
 }
 
+int Shader::getLocation(const std::string &name) const
+{
+    auto it = uniformLocations.find(name);
+    return it == uniformLocations.end() ? -1 : it->second;
+}
+
+void Shader::set(Uniform<bool> uniform, bool value) const
+{
+    glUniform1i(uniform.location, (int)value);
+}
+
+void Shader::set(Uniform<int> uniform, int value) const
+{
+    glUniform1i(uniform.location, value);
+}
+
+void Shader::set(Uniform<float> uniform, float value) const
+{
+    glUniform1f(uniform.location, value);
+}
+
+void Shader::set(Uniform<glm::mat4> uniform, const glm::mat4 &value) const
+{
+    glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::set(Uniform<glm::vec3> uniform, const glm::vec3 &value) const
+{
+    glUniform3f(uniform.location, value.x, value.y, value.z);
+}
+
+void Shader::set(Uniform<glm::vec3> uniform, const glm::vec3 *values, int count) const
+{
+    glUniform3fv(uniform.location, count, &values[0].x);
+}
+
+void Shader::set(Uniform<glm::vec4> uniform, const glm::vec4 &value) const
+{
+    glUniform4f(uniform.location, value.x, value.y, value.z, value.w);
+}
+
+void Shader::set(Uniform<glm::ivec2> uniform, const glm::ivec2 &value) const
+{
+    glUniform2i(uniform.location, value.x, value.y);
+}
+
 void Shader::setBool(const std::string &name, bool value) const
 {         
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+    glUniform1i(getLocation(name), (int)value); 
 }
 
 void Shader::setInt(const std::string &name, int value) const
 { 
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+    glUniform1i(getLocation(name), value); 
 }
 
 void Shader::setFloat(const std::string &name, float value) const
 { 
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+    glUniform1f(getLocation(name), value); 
 }
 
 void Shader::setMat4(const std::string &name, glm::mat4 value) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+    glUniformMatrix4fv(getLocation(name), 1, GL_FALSE, glm::value_ptr(value));
 }
 
 void Shader::setVec3(const std::string &name, float x, float y, float z) const
 {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    glUniform3f(getLocation(name), x, y, z);
 }
 
 void Shader::setVec3(const std::string &name, glm::vec3 vector) const
 {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), vector.x, vector.y, vector.z);
+    glUniform3f(getLocation(name), vector.x, vector.y, vector.z);
 }
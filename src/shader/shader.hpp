@@ -4,16 +4,47 @@
 #include <glad/glad.h>
   
 #include <glm/ext/matrix_float4x4.hpp>
+#include <glm/ext/vector_int2.hpp>
 #include <string>
+#include <unordered_map>
+
+// Location of a uniform resolved once from a Shader, typed by the value it takes.
+template <typename T>
+struct Uniform
+{
+    int location = -1;
+};
 
 class Shader
 {
 public:
     unsigned int ID;
   
-    Shader(const char* vertexPath, const char* fragmentPath);
+    // defines are inserted after the #version line of both stages, e.g. "#define FOO\n"
+    Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = "");
+    // Compute program from a single stage, run with glDispatchCompute after use(). Named so a
+    // path and defines can never be taken for a vertex and fragment path.
+    static Shader compute(const char* computePath, const std::string& defines = "");
 
     void use();
+    // Issues a draw that produces no fragments so the first real frame does not pay for pipeline creation.
+    void warmUp();
+
+    // Active uniform lookup from the table built at link time, -1 if the uniform is not active.
+    int getLocation(const std::string &name) const;
+
+    template <typename T>
+    Uniform<T> uniform(const std::string &name) const { return Uniform<T>{ getLocation(name) }; }
+
+    void set(Uniform<bool> uniform, bool value) const;
+    void set(Uniform<int> uniform, int value) const;
+    void set(Uniform<float> uniform, float value) const;
+    void set(Uniform<glm::mat4> uniform, const glm::mat4 &value) const;
+    void set(Uniform<glm::vec3> uniform, const glm::vec3 &value) const;
+    // Sets count elements of an array uniform starting at the element uniform refers to
+    void set(Uniform<glm::vec3> uniform, const glm::vec3 *values, int count) const;
+    void set(Uniform<glm::vec4> uniform, const glm::vec4 &value) const;
+    void set(Uniform<glm::ivec2> uniform, const glm::ivec2 &value) const;
 
     void setBool(const std::string &name, bool value) const;  
     void setInt(const std::string &name, int value) const;   
@@ -21,6 +52,13 @@ public:
     void setMat4(const std::string &name, glm::mat4 value) const;
     void setVec3(const std::string &name, float x, float y, float z) const;
     void setVec3(const std::string &name, glm::vec3 vector) const;
+
+private:
+    std::unordered_map<std::string, int> uniformLocations;
+
+    Shader() : ID(0) {}
+
+    void reflectUniforms();
 };
   
 #endif
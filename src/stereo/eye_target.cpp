@@ -0,0 +1,62 @@
+#include <iostream>
+
+#include "eye_target.hpp"
+
+static void checkFramebuffer(const char* name)
+{
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER::" << name << "::INCOMPLETE" << std::endl;
+}
+
+EyeTarget::EyeTarget(unsigned int width, unsigned int height) : width(width), height(height)
+{
+    glGenTextures(1, &colorTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, colorTexture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGB8, width, height, 2);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glGenTextures(1, &depthTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH24_STENCIL8, width, height, 2);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGenFramebuffers(1, &layeredFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, layeredFBO);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorTexture, 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, depthTexture, 0);
+    checkFramebuffer("LAYERED");
+
+    glGenFramebuffers(2, eyeFBO);
+    for (int eye = 0; eye < 2; eye++)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, eyeFBO[eye]);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorTexture, 0, eye);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, depthTexture, 0, eye);
+        checkFramebuffer(eye == LEFT_EYE ? "LEFT_EYE" : "RIGHT_EYE");
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+EyeTarget::~EyeTarget()
+{
+    glDeleteFramebuffers(1, &layeredFBO);
+    glDeleteFramebuffers(2, eyeFBO);
+    glDeleteTextures(1, &colorTexture);
+    glDeleteTextures(1, &depthTexture);
+}
+
+void EyeTarget::bindLayered() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, layeredFBO);
+    glViewport(0, 0, width, height);
+}
+
+void EyeTarget::bindEye(EyeIndex eye) const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, eyeFBO[eye]);
+    glViewport(0, 0, width, height);
+}
@@ -0,0 +1,34 @@
+#ifndef EYE_TARGET_H
+#define EYE_TARGET_H
+
+#include <glad/glad.h>
+
+enum EyeIndex
+{
+    LEFT_EYE = 0,
+    RIGHT_EYE = 1
+};
+
+// Colour and depth for both eyes as two-layer texture arrays. Each layer can be
+// bound on its own (two pass) or both at once as a layered framebuffer (single pass).
+class EyeTarget
+{
+public:
+    unsigned int colorTexture;
+    unsigned int depthTexture;
+    unsigned int width, height;
+
+    EyeTarget(unsigned int width, unsigned int height);
+    ~EyeTarget();
+    EyeTarget(const EyeTarget&) = delete;
+    EyeTarget& operator=(const EyeTarget&) = delete;
+
+    void bindLayered() const;
+    void bindEye(EyeIndex eye) const;
+
+private:
+    unsigned int layeredFBO;
+    unsigned int eyeFBO[2];
+};
+
+#endif
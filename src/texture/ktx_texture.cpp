@@ -0,0 +1,401 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "ktx_texture.hpp"
+
+static const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const char KTX2_WRITER[] = "stereo-render-gl ktx_convert";
+
+struct Ktx2Header
+{
+    unsigned char identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+
+struct Ktx2LevelIndex
+{
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+// Vulkan formats this renderer can upload; blockBytes is per 4x4 block, 0 for 4 byte texels
+struct Ktx2Format
+{
+    uint32_t vkFormat;
+    GLenum internalFormat;
+    unsigned int blockBytes;
+};
+
+static const Ktx2Format KTX2_FORMATS[] = {
+    { 37, GL_RGBA8, 0 },                                     // VK_FORMAT_R8G8B8A8_UNORM
+    { 43, GL_SRGB8_ALPHA8, 0 },                              // VK_FORMAT_R8G8B8A8_SRGB
+    { 131, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 8 },             // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+    { 132, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, 8 },            // VK_FORMAT_BC1_RGB_SRGB_BLOCK
+    { 137, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 16 },           // VK_FORMAT_BC3_UNORM_BLOCK
+    { 138, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 16 },     // VK_FORMAT_BC3_SRGB_BLOCK
+    { 145, GL_COMPRESSED_RGBA_BPTC_UNORM, 16 },              // VK_FORMAT_BC7_UNORM_BLOCK
+    { 146, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 16 }         // VK_FORMAT_BC7_SRGB_BLOCK
+};
+
+static const Ktx2Format* findFormat(uint32_t vkFormat, GLenum internalFormat)
+{
+    for (const Ktx2Format& format : KTX2_FORMATS)
+    {
+        if (format.vkFormat == vkFormat || format.internalFormat == internalFormat)
+            return &format;
+    }
+    return nullptr;
+}
+
+static size_t levelImageSize(const Ktx2Format& format, unsigned int width, unsigned int height, unsigned int level)
+{
+    width = std::max(width >> level, 1u);
+    height = std::max(height >> level, 1u);
+    if (format.blockBytes == 0)
+        return static_cast<size_t>(width) * height * 4;
+    return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * format.blockBytes;
+}
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+bool isKtx2Path(const std::string& path)
+{
+    return path.size() > 5 && path.compare(path.size() - 5, 5, ".ktx2") == 0;
+}
+
+std::string ktx2PathFor(const std::string& imagePath)
+{
+    if (isKtx2Path(imagePath))
+        return imagePath;
+
+    size_t slash = imagePath.find_last_of('/');
+    size_t dot = imagePath.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return imagePath + ".ktx2";
+    return imagePath.substr(0, dot) + ".ktx2";
+}
+
+Ktx2File::Ktx2File() : mapping(MAP_FAILED), mappingSize(0)
+{
+}
+
+Ktx2File::~Ktx2File()
+{
+    close();
+}
+
+void Ktx2File::close()
+{
+    if (mapping != MAP_FAILED)
+        munmap(mapping, mappingSize);
+
+    mapping = MAP_FAILED;
+    mappingSize = 0;
+    levels.clear();
+    inflated.clear();
+}
+
+size_t Ktx2File::imageSize(unsigned int level) const
+{
+    return levelImageSize(*findFormat(0, format), pixelWidth, pixelHeight, level);
+}
+
+const unsigned char* Ktx2File::imageData(unsigned int level, unsigned int face) const
+{
+    return levels[level] + face * imageSize(level);
+}
+
+bool Ktx2File::open(const std::string& path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Ktx2Header))
+    {
+        ::close(fd);
+        std::cout << "ERROR::KTX::TRUNCATED " << path << std::endl;
+        return false;
+    }
+
+    mappingSize = st.st_size;
+    mapping = mmap(NULL, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    const unsigned char* base = static_cast<const unsigned char*>(mapping);
+    Ktx2Header header;
+    std::memcpy(&header, base, sizeof(header));
+
+    const char* problem = nullptr;
+    const Ktx2Format* fileFormat = findFormat(header.vkFormat, 0);
+    unsigned int levelCount = std::max(header.levelCount, 1u);
+    if (std::memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+        problem = "NOT_KTX2";
+    else if (!fileFormat)
+        problem = "UNSUPPORTED_FORMAT";
+    else if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 || header.layerCount != 0
+             || (header.faceCount != 1 && header.faceCount != 6) || levelCount > 32)
+        problem = "UNSUPPORTED_DIMENSIONS";
+    else if (header.supercompressionScheme != KTX2_SUPERCOMPRESSION_NONE && header.supercompressionScheme != KTX2_SUPERCOMPRESSION_ZSTD)
+        problem = "UNSUPPORTED_SUPERCOMPRESSION";
+    else if (sizeof(Ktx2Header) + levelCount * sizeof(Ktx2LevelIndex) > mappingSize)
+        problem = "TRUNCATED";
+
+#ifndef HAVE_ZSTD
+    if (!problem && header.supercompressionScheme == KTX2_SUPERCOMPRESSION_ZSTD)
+        problem = "ZSTD_NOT_BUILT_IN";
+#endif
+
+    if (!problem)
+    {
+        pixelWidth = header.pixelWidth;
+        pixelHeight = header.pixelHeight;
+        faces = header.faceCount;
+        format = fileFormat->internalFormat;
+    }
+
+    for (unsigned int level = 0; level < levelCount && !problem; level++)
+    {
+        Ktx2LevelIndex index;
+        std::memcpy(&index, base + sizeof(Ktx2Header) + level * sizeof(Ktx2LevelIndex), sizeof(index));
+        size_t expected = faces * levelImageSize(*fileFormat, pixelWidth, pixelHeight, level);
+
+        if (index.byteOffset + index.byteLength > mappingSize)
+            problem = "TRUNCATED";
+        else if (header.supercompressionScheme == KTX2_SUPERCOMPRESSION_NONE)
+        {
+            if (index.byteLength != expected)
+                problem = "BAD_LEVEL_SIZE";
+            else
+                levels.push_back(base + index.byteOffset);
+        }
+        else
+        {
+#ifdef HAVE_ZSTD
+            std::vector<unsigned char> data(expected);
+            size_t size = ZSTD_decompress(data.data(), data.size(), base + index.byteOffset, index.byteLength);
+            if (index.uncompressedByteLength != expected || ZSTD_isError(size) || size != expected)
+                problem = "BAD_ZSTD_LEVEL";
+            else
+            {
+                inflated.push_back(std::move(data));
+                levels.push_back(inflated.back().data());
+            }
+#endif
+        }
+    }
+
+    if (problem)
+    {
+        std::cout << "ERROR::KTX::" << problem << " " << path << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+// Khronos basic data format descriptor for the formats written by writeKtx2
+static std::vector<uint32_t> dataFormatDescriptor(GLenum internalFormat)
+{
+    struct Sample
+    {
+        uint32_t bitOffset, bitLength, channel, upper;
+    };
+
+    uint32_t colorModel, bytesPerBlock, blockDimensions = 3 | (3 << 8);
+    std::vector<Sample> samples;
+    if (internalFormat == GL_RGBA8)
+    {
+        // RGBSDA model, alpha is channel 15
+        colorModel = 1;
+        bytesPerBlock = 4;
+        blockDimensions = 0;
+        samples = { { 0, 8, 0, 255 }, { 8, 8, 1, 255 }, { 16, 8, 2, 255 }, { 24, 8, 15, 255 } };
+    }
+    else if (internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+    {
+        colorModel = 128;
+        bytesPerBlock = 8;
+        samples = { { 0, 64, 0, 0xFFFFFFFF } };
+    }
+    else if (internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+    {
+        colorModel = 130;
+        bytesPerBlock = 16;
+        samples = { { 0, 64, 15, 0xFFFFFFFF }, { 64, 64, 0, 0xFFFFFFFF } };
+    }
+    else
+    {
+        colorModel = 134;
+        bytesPerBlock = 16;
+        samples = { { 0, 128, 0, 0xFFFFFFFF } };
+    }
+
+    uint32_t blockSize = 24 + 16 * samples.size();
+    std::vector<uint32_t> words = {
+        4 + blockSize,
+        0,                                  // Khronos vendor, basic descriptor type
+        2 | (blockSize << 16),              // version 1.3
+        colorModel | (1 << 8) | (1 << 16),  // BT.709 primaries, linear transfer (UNORM formats)
+        blockDimensions,
+        bytesPerBlock,
+        0
+    };
+    for (const Sample& sample : samples)
+    {
+        words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (sample.channel << 24));
+        words.push_back(0);
+        words.push_back(0);
+        words.push_back(sample.upper);
+    }
+    return words;
+}
+
+bool writeKtx2(const std::string& path, const std::vector<MipChain>& faceChains, int zstdLevel)
+{
+    const MipChain& first = faceChains.front();
+    const Ktx2Format* fileFormat = findFormat(0, first.internalFormat);
+    bool matching = (faceChains.size() == 1 || faceChains.size() == 6) && fileFormat && !first.levels.empty();
+    for (const MipChain& chain : faceChains)
+    {
+        matching = matching && chain.internalFormat == first.internalFormat && chain.levels.size() == first.levels.size()
+            && chain.levels[0].width == first.levels[0].width && chain.levels[0].height == first.levels[0].height;
+    }
+    if (!matching)
+    {
+        std::cout << "ERROR::KTX::MISMATCHED_FACES " << path << std::endl;
+        return false;
+    }
+
+#ifndef HAVE_ZSTD
+    if (zstdLevel > 0)
+    {
+        std::cout << "ERROR::KTX::ZSTD_NOT_BUILT_IN " << path << std::endl;
+        return false;
+    }
+#endif
+
+    // Each level holds every face's image back to back
+    unsigned int levelCount = first.levels.size();
+    std::vector<std::vector<unsigned char>> levelData(levelCount);
+    std::vector<uint64_t> uncompressedSizes(levelCount);
+    for (unsigned int level = 0; level < levelCount; level++)
+    {
+        for (const MipChain& chain : faceChains)
+        {
+            const MipLevel& entry = chain.levels[level];
+            levelData[level].insert(levelData[level].end(), chain.data.begin() + entry.offset, chain.data.begin() + entry.offset + entry.size);
+        }
+        uncompressedSizes[level] = levelData[level].size();
+
+#ifdef HAVE_ZSTD
+        if (zstdLevel > 0)
+        {
+            std::vector<unsigned char> packed(ZSTD_compressBound(levelData[level].size()));
+            size_t size = ZSTD_compress(packed.data(), packed.size(), levelData[level].data(), levelData[level].size(), zstdLevel);
+            if (ZSTD_isError(size))
+            {
+                std::cout << "ERROR::KTX::ZSTD_FAILED " << ZSTD_getErrorName(size) << std::endl;
+                return false;
+            }
+            packed.resize(size);
+            levelData[level].swap(packed);
+        }
+#endif
+    }
+
+    std::vector<uint32_t> dfd = dataFormatDescriptor(first.internalFormat);
+
+    // Key/value data: only the writer, as the spec asks for
+    std::vector<unsigned char> kvd;
+    uint32_t entryLength = sizeof("KTXwriter") + sizeof(KTX2_WRITER);
+    kvd.resize(4);
+    std::memcpy(kvd.data(), &entryLength, 4);
+    kvd.insert(kvd.end(), "KTXwriter", "KTXwriter" + sizeof("KTXwriter"));
+    kvd.insert(kvd.end(), KTX2_WRITER, KTX2_WRITER + sizeof(KTX2_WRITER));
+    kvd.resize(alignUp(kvd.size(), 4), 0);
+
+    Ktx2Header header = {};
+    std::memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    header.vkFormat = fileFormat->vkFormat;
+    header.typeSize = 1;
+    header.pixelWidth = first.levels[0].width;
+    header.pixelHeight = first.levels[0].height;
+    header.faceCount = faceChains.size();
+    header.levelCount = levelCount;
+    header.supercompressionScheme = zstdLevel > 0 ? KTX2_SUPERCOMPRESSION_ZSTD : KTX2_SUPERCOMPRESSION_NONE;
+    header.dfdByteOffset = sizeof(Ktx2Header) + levelCount * sizeof(Ktx2LevelIndex);
+    header.dfdByteLength = dfd.size() * sizeof(uint32_t);
+    header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+    header.kvdByteLength = kvd.size();
+
+    // Levels go smallest first, each aligned for its texel blocks unless supercompressed
+    size_t alignment = zstdLevel > 0 ? 1 : 16;
+    std::vector<Ktx2LevelIndex> index(levelCount);
+    size_t cursor = header.kvdByteOffset + header.kvdByteLength;
+    for (int level = levelCount - 1; level >= 0; level--)
+    {
+        cursor = alignUp(cursor, alignment);
+        index[level].byteOffset = cursor;
+        index[level].byteLength = levelData[level].size();
+        index[level].uncompressedByteLength = uncompressedSizes[level];
+        cursor += levelData[level].size();
+    }
+
+    std::vector<unsigned char> buffer(cursor, 0);
+    std::memcpy(&buffer[0], &header, sizeof(header));
+    std::memcpy(&buffer[sizeof(header)], index.data(), index.size() * sizeof(Ktx2LevelIndex));
+    std::memcpy(&buffer[header.dfdByteOffset], dfd.data(), header.dfdByteLength);
+    std::memcpy(&buffer[header.kvdByteOffset], kvd.data(), kvd.size());
+    for (unsigned int level = 0; level < levelCount; level++)
+        std::memcpy(&buffer[index[level].byteOffset], levelData[level].data(), levelData[level].size());
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        std::cout << "ERROR::KTX::CANNOT_WRITE " << path << std::endl;
+        return false;
+    }
+    bool written = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    written = std::fclose(file) == 0 && written;
+    if (!written)
+    {
+        std::cout << "ERROR::KTX::CANNOT_WRITE " << path << std::endl;
+        std::remove(path.c_str());
+    }
+    return written;
+}
@@ -0,0 +1,60 @@
+#ifndef KTX_TEXTURE_H
+#define KTX_TEXTURE_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "texture_compression.hpp"
+
+// KTX2 supercompression schemes; Zstandard needs the build to define HAVE_ZSTD and link -lzstd
+const uint32_t KTX2_SUPERCOMPRESSION_NONE = 0;
+const uint32_t KTX2_SUPERCOMPRESSION_ZSTD = 2;
+
+// The same image as a KTX2 file: "<stem>.ktx2" beside it, or the path itself if it already is one
+std::string ktx2PathFor(const std::string& imagePath);
+bool isKtx2Path(const std::string& path);
+
+// A KTX2 file mapped into memory, with level and face images pointing straight into the
+// mapping. Zstandard supercompressed levels are inflated into memory owned by the file.
+// Only 2D textures and cubemaps (no arrays, no 3D) in the formats this renderer uploads.
+class Ktx2File
+{
+public:
+    Ktx2File();
+    ~Ktx2File();
+    Ktx2File(const Ktx2File&) = delete;
+    Ktx2File& operator=(const Ktx2File&) = delete;
+
+    // False if the file is missing; a file that exists but cannot be used also prints why
+    bool open(const std::string& path);
+
+    unsigned int width() const { return pixelWidth; }
+    unsigned int height() const { return pixelHeight; }
+    unsigned int levelCount() const { return static_cast<unsigned int>(levels.size()); }
+    unsigned int faceCount() const { return faces; }
+    GLenum internalFormat() const { return format; }
+    size_t imageSize(unsigned int level) const;
+    const unsigned char* imageData(unsigned int level, unsigned int face) const;
+    bool supercompressed() const { return !inflated.empty(); }
+
+private:
+    void* mapping;
+    size_t mappingSize;
+    unsigned int pixelWidth = 0, pixelHeight = 0, faces = 0;
+    GLenum format = 0;
+    // Start of each level, level 0 first
+    std::vector<const unsigned char*> levels;
+    std::vector<std::vector<unsigned char>> inflated;
+
+    void close();
+};
+
+// Writes one mip chain as a 2D texture, or six (+X, -X, +Y, -Y, +Z, -Z) as a cubemap; every
+// chain must share a size and format. zstdLevel > 0 supercompresses each level with Zstandard.
+bool writeKtx2(const std::string& path, const std::vector<MipChain>& faceChains, int zstdLevel = 0);
+
+#endif
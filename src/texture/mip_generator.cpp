@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../util/thread_pool.hpp"
+#include "mip_generator.hpp"
+
+// Target rows per worker pool job
+const unsigned int MIP_ROWS_PER_BAND = 16;
+
+static MipFilter activeFilter = MIP_FILTER_KAISER;
+
+// Source texel weights for one target texel along one axis. Target texel x sits between
+// source texels 2x and 2x + 1; tap i reads source texel 2x + firstTap + i.
+struct MipKernel
+{
+    int firstTap;
+    unsigned int tapCount;
+    float weights[8];
+};
+
+static float besselI0(float x)
+{
+    float sum = 1.0f, term = 1.0f;
+    for (int k = 1; k < 20; k++)
+    {
+        float half = x / (2.0f * k);
+        term *= half * half;
+        sum += term;
+    }
+    return sum;
+}
+
+static MipKernel makeKernel(MipFilter filter)
+{
+    MipKernel kernel;
+    if (filter == MIP_FILTER_BOX)
+    {
+        kernel.firstTap = 0;
+        kernel.tapCount = 2;
+        kernel.weights[0] = kernel.weights[1] = 0.5f;
+        return kernel;
+    }
+
+    // Sinc at the target rate under a Kaiser window two target texels wide each side
+    const float pi = 3.14159265358979f, beta = 4.0f, radius = 2.0f;
+    kernel.firstTap = -3;
+    kernel.tapCount = 8;
+    float sum = 0.0f;
+    for (unsigned int i = 0; i < kernel.tapCount; i++)
+    {
+        float t = (kernel.firstTap + static_cast<int>(i) - 0.5f) / 2.0f;
+        float ratio = t / radius;
+        float window = besselI0(beta * std::sqrt(std::max(0.0f, 1.0f - ratio * ratio))) / besselI0(beta);
+        kernel.weights[i] = std::sin(pi * t) / (pi * t) * window;
+        sum += kernel.weights[i];
+    }
+    for (unsigned int i = 0; i < kernel.tapCount; i++)
+        kernel.weights[i] /= sum;
+    return kernel;
+}
+
+// 8 bit channel values to and from the space they are filtered in
+struct GammaTables
+{
+    float toLinear[256];
+    // Indexed by linear value * 65535, fine enough that the dark end does not band
+    unsigned char toStored[65536];
+
+    // Data maps straight through, so both kinds of content share one filter loop
+    explicit GammaTables(TextureContent content)
+    {
+        bool srgb = content == TEXTURE_CONTENT_COLOR;
+        for (int i = 0; i < 256; i++)
+        {
+            float c = i / 255.0f;
+            toLinear[i] = !srgb ? c : c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (int i = 0; i < 65536; i++)
+        {
+            float l = i / 65535.0f;
+            float c = !srgb ? l : l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            toStored[i] = static_cast<unsigned char>(c * 255.0f + 0.5f);
+        }
+    }
+};
+
+static const GammaTables& gammaTables(TextureContent content)
+{
+    static GammaTables color(TEXTURE_CONTENT_COLOR);
+    static GammaTables data(TEXTURE_CONTENT_DATA);
+    return content == TEXTURE_CONTENT_COLOR ? color : data;
+}
+
+// One linear RGBA texel, four floats wide
+#if defined(__SSE2__)
+typedef __m128 Texel;
+
+static inline Texel texelZero() { return _mm_setzero_ps(); }
+static inline Texel texelLoad(const float* texel) { return _mm_loadu_ps(texel); }
+static inline void texelStore(float* texel, Texel value) { _mm_storeu_ps(texel, value); }
+static inline Texel texelMulAdd(Texel sum, Texel texel, float weight) { return _mm_add_ps(sum, _mm_mul_ps(texel, _mm_set1_ps(weight))); }
+
+static inline void texelEncode(Texel value, const GammaTables& tables, unsigned char* out)
+{
+    __m128 clamped = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    int scaled[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(scaled), _mm_cvtps_epi32(_mm_mul_ps(clamped, _mm_set1_ps(65535.0f))));
+    out[0] = tables.toStored[scaled[0]];
+    out[1] = tables.toStored[scaled[1]];
+    out[2] = tables.toStored[scaled[2]];
+    out[3] = static_cast<unsigned char>((scaled[3] * 255 + 32767) / 65535);
+}
+#else
+struct Texel
+{
+    float v[4];
+};
+
+static inline Texel texelZero() { return Texel{ { 0.0f, 0.0f, 0.0f, 0.0f } }; }
+static inline Texel texelLoad(const float* texel) { return Texel{ { texel[0], texel[1], texel[2], texel[3] } }; }
+static inline void texelStore(float* texel, Texel value) { std::copy(value.v, value.v + 4, texel); }
+static inline Texel texelMulAdd(Texel sum, Texel texel, float weight)
+{
+    for (int c = 0; c < 4; c++)
+        sum.v[c] += texel.v[c] * weight;
+    return sum;
+}
+
+static inline void texelEncode(Texel value, const GammaTables& tables, unsigned char* out)
+{
+    int scaled[4];
+    for (int c = 0; c < 4; c++)
+        scaled[c] = static_cast<int>(std::min(std::max(value.v[c], 0.0f), 1.0f) * 65535.0f + 0.5f);
+    out[0] = tables.toStored[scaled[0]];
+    out[1] = tables.toStored[scaled[1]];
+    out[2] = tables.toStored[scaled[2]];
+    out[3] = static_cast<unsigned char>((scaled[3] * 255 + 32767) / 65535);
+}
+#endif
+
+static int clampIndex(int index, unsigned int size)
+{
+    return std::min(std::max(index, 0), static_cast<int>(size) - 1);
+}
+
+// Target rows [firstRow, lastRow): the source rows under the kernel are filtered horizontally
+// into linear floats first, then each target row is a vertical pass over those.
+static void downsampleBand(const unsigned char* source, unsigned int width, unsigned int height, unsigned char* target,
+                           const MipKernel& kernel, const GammaTables& tables, unsigned int firstRow, unsigned int lastRow)
+{
+    unsigned int targetWidth = std::max(width / 2, 1u);
+    int firstSourceRow = 2 * firstRow + kernel.firstTap;
+    unsigned int rowCount = 2 * (lastRow - 1 - firstRow) + kernel.tapCount;
+
+    std::vector<float> linearRow(width * 4);
+    std::vector<float> filtered(rowCount * targetWidth * 4);
+    for (unsigned int r = 0; r < rowCount; r++)
+    {
+        const unsigned char* row = source + static_cast<size_t>(clampIndex(firstSourceRow + r, height)) * width * 4;
+        for (unsigned int x = 0; x < width; x++)
+        {
+            linearRow[x * 4] = tables.toLinear[row[x * 4]];
+            linearRow[x * 4 + 1] = tables.toLinear[row[x * 4 + 1]];
+            linearRow[x * 4 + 2] = tables.toLinear[row[x * 4 + 2]];
+            linearRow[x * 4 + 3] = row[x * 4 + 3] / 255.0f;
+        }
+
+        float* out = &filtered[r * targetWidth * 4];
+        for (unsigned int x = 0; x < targetWidth; x++)
+        {
+            Texel sum = texelZero();
+            for (unsigned int i = 0; i < kernel.tapCount; i++)
+                sum = texelMulAdd(sum, texelLoad(&linearRow[clampIndex(2 * x + kernel.firstTap + i, width) * 4]), kernel.weights[i]);
+            texelStore(out + x * 4, sum);
+        }
+    }
+
+    for (unsigned int y = firstRow; y < lastRow; y++)
+    {
+        const float* rows = &filtered[2 * (y - firstRow) * targetWidth * 4];
+        unsigned char* out = target + static_cast<size_t>(y) * targetWidth * 4;
+        for (unsigned int x = 0; x < targetWidth; x++)
+        {
+            Texel sum = texelZero();
+            for (unsigned int i = 0; i < kernel.tapCount; i++)
+                sum = texelMulAdd(sum, texelLoad(rows + (i * targetWidth + x) * 4), kernel.weights[i]);
+            texelEncode(sum, tables, out + x * 4);
+        }
+    }
+}
+
+unsigned int mipLevelCount(unsigned int width, unsigned int height)
+{
+    unsigned int levels = 1;
+    while (width > 1 || height > 1)
+    {
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+        levels++;
+    }
+    return levels;
+}
+
+void downsampleLevel(const unsigned char* source, unsigned int width, unsigned int height, unsigned char* target, MipFilter filter, TextureContent content)
+{
+    const GammaTables& tables = gammaTables(content);
+    static const MipKernel boxKernel = makeKernel(MIP_FILTER_BOX);
+    static const MipKernel kaiserKernel = makeKernel(MIP_FILTER_KAISER);
+    const MipKernel& kernel = filter == MIP_FILTER_BOX ? boxKernel : kaiserKernel;
+
+    unsigned int targetHeight = std::max(height / 2, 1u);
+    unsigned int bands = (targetHeight + MIP_ROWS_PER_BAND - 1) / MIP_ROWS_PER_BAND;
+    workerPool().parallelFor(bands, [&](unsigned int band) {
+        unsigned int firstRow = band * MIP_ROWS_PER_BAND;
+        downsampleBand(source, width, height, target, kernel, tables, firstRow, std::min(firstRow + MIP_ROWS_PER_BAND, targetHeight));
+    });
+}
+
+void setMipFilter(MipFilter filter)
+{
+    activeFilter = filter;
+}
+
+MipFilter mipFilter()
+{
+    return activeFilter;
+}
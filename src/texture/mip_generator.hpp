@@ -0,0 +1,32 @@
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+// Filter used to build each mip level from the one above it. Kaiser is a windowed sinc over
+// 8 texels per axis, sharper than the 2x2 box without its aliasing.
+enum MipFilter
+{
+    MIP_FILTER_BOX,
+    MIP_FILTER_KAISER
+};
+
+// What a texture's channels hold. Color (diffuse maps, the skybox) is stored as sRGB and
+// filtered in linear light; data such as specular maps is filtered as the values it stores.
+enum TextureContent
+{
+    TEXTURE_CONTENT_COLOR,
+    TEXTURE_CONTENT_DATA
+};
+
+// Levels in a full chain down to 1x1
+unsigned int mipLevelCount(unsigned int width, unsigned int height);
+
+// Filters an RGBA8 level into the next one, max(width / 2, 1) by max(height / 2, 1), clamping
+// at the edges. Color content is taken as sRGB and filtered in linear light, data content and
+// alpha as plain values. Rows are split across the worker pool; callable from a worker.
+void downsampleLevel(const unsigned char* source, unsigned int width, unsigned int height, unsigned char* target, MipFilter filter, TextureContent content);
+
+// Filter applied to every decode queued from now on
+void setMipFilter(MipFilter filter);
+MipFilter mipFilter();
+
+#endif
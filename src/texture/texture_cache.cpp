@@ -0,0 +1,213 @@
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+
+#include "texture_cache.hpp"
+
+static std::string canonicalPath(const std::string& path)
+{
+    // Collapses ./, ../ and symlinks; a missing file keeps its path and fails at decode
+    char resolved[PATH_MAX];
+    if (realpath(path.c_str(), resolved))
+        return resolved;
+    return path;
+}
+
+unsigned int TextureCache::acquire(const std::string& path, TextureContent content)
+{
+    std::string canonical = canonicalPath(path);
+
+    auto known = byPath[content].find(canonical);
+    if (known != byPath[content].end())
+    {
+        counters.pathHits++;
+        entries[known->second].references++;
+        return known->second;
+    }
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    Entry& entry = entries[textureID];
+    entry.references = 1;
+    entry.content = content;
+    entry.contentHash = 0;
+    entry.paths.push_back(canonical);
+    byPath[content][canonical] = textureID;
+
+    // Nothing here touches the file: the worker maps the converted KTX2 beside it if there is
+    // one, or else reads and hashes the image, and advance() takes it from there
+    Pending job;
+    job.texture = textureID;
+    job.content = content;
+    job.source = readTextureSourceAsync(canonical, true);
+    pending.push_back(std::move(job));
+    return textureID;
+}
+
+unsigned int TextureCache::settle(unsigned int textureID)
+{
+    auto aliased = aliases.find(textureID);
+    if (aliased == aliases.end())
+        return textureID;
+
+    // The name stays reserved until nothing refers to it, so it cannot come back from
+    // glGenTextures while another holder still has to settle or release it
+    unsigned int target = aliased->second.texture;
+    if (--aliased->second.references == 0)
+    {
+        aliases.erase(aliased);
+        glDeleteTextures(1, &textureID);
+    }
+    return target;
+}
+
+void TextureCache::release(unsigned int textureID)
+{
+    textureID = settle(textureID);
+    auto found = entries.find(textureID);
+    if (found == entries.end())
+    {
+        std::cout << "ERROR::TEXTURE_CACHE::RELEASE_OF_UNKNOWN_TEXTURE " << textureID << std::endl;
+        return;
+    }
+
+    Entry& entry = found->second;
+    if (--entry.references > 0)
+        return;
+
+    for (const std::string& path : entry.paths)
+        byPath[entry.content].erase(path);
+    auto content = byContent[entry.content].find(entry.contentHash);
+    if (content != byContent[entry.content].end() && content->second == textureID)
+        byContent[entry.content].erase(content);
+    entries.erase(found);
+
+    // A read or decode still queued is dropped with the texture: glGenTextures can hand the name out
+    // again, and the stale pixels must not land in whatever texture gets it next. The worker
+    // finishes the job and the result is thrown away.
+    for (auto queued = pending.begin(); queued != pending.end();)
+    {
+        if (queued->texture == textureID)
+            queued = pending.erase(queued);
+        else
+            ++queued;
+    }
+
+    glDeleteTextures(1, &textureID);
+    counters.freed++;
+}
+
+// Takes a job through whichever of its stages have finished, or wait for them; true once the
+// texture is uploaded or turned out to be a copy, and the job is done
+bool TextureCache::advance(Pending& job, bool wait)
+{
+    if (job.source.valid())
+    {
+        if (!wait && job.source.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return false;
+        TextureSource source = job.source.get();
+
+        if (source.ktx2)
+        {
+            if (uploadKtx2Texture2D(job.texture, *source.ktx2, ktx2PathFor(source.path)))
+            {
+                counters.misses++;
+                return true;
+            }
+            // A format the driver cannot sample: read the image after all
+            job.source = readTextureSourceAsync(source.path, false);
+            return wait && advance(job, wait);
+        }
+
+        // Registered before the decode, so copies acquired meanwhile alias this texture too
+        if (source.contentHash)
+        {
+            Entry& entry = entries[job.texture];
+            auto duplicate = byContent[job.content].find(source.contentHash);
+            if (duplicate != byContent[job.content].end())
+            {
+                counters.contentHits++;
+                alias(job.texture, duplicate->second);
+                return true;
+            }
+            entry.contentHash = source.contentHash;
+            byContent[job.content][source.contentHash] = job.texture;
+        }
+        job.image = decodeSourceAsync(source, job.content);
+    }
+
+    if (!wait && job.image.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return false;
+    DecodedImage image = job.image.get();
+    counters.misses++;
+    uploadTexture2D(job.texture, image);
+    return true;
+}
+
+void TextureCache::alias(unsigned int textureID, unsigned int target)
+{
+    // Every reference and path moves over to the texture already holding these contents
+    Entry& entry = entries[textureID];
+    Entry& into = entries[target];
+    into.references += entry.references;
+    for (const std::string& path : entry.paths)
+    {
+        byPath[entry.content][path] = target;
+        into.paths.push_back(path);
+    }
+    aliases[textureID] = Alias{ target, entry.references };
+    entries.erase(textureID);
+}
+
+unsigned int TextureCache::uploadPending()
+{
+    unsigned int count = pending.size();
+    for (Pending& job : pending)
+        advance(job, true);
+    pending.clear();
+    return count;
+}
+
+unsigned int TextureCache::uploadReady(double budgetMs)
+{
+    auto start = std::chrono::steady_clock::now();
+    unsigned int count = 0;
+    for (auto queued = pending.begin(); queued != pending.end();)
+    {
+        if (count > 0 && std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() >= budgetMs)
+            break;
+        if (!advance(*queued, false))
+        {
+            ++queued;
+            continue;
+        }
+
+        queued = pending.erase(queued);
+        count++;
+    }
+    return count;
+}
+
+bool TextureCache::isPending(unsigned int textureID) const
+{
+    for (const Pending& queued : pending)
+    {
+        if (queued.texture == textureID)
+            return true;
+    }
+    return false;
+}
+
+void TextureCache::printStats() const
+{
+    std::cout << "Texture cache: " << entries.size() << " live, " << counters.pathHits << " path hits, " << counters.contentHits
+              << " content hits, " << counters.misses << " misses, " << counters.freed << " freed" << std::endl;
+}
+
+TextureCache& textureCache()
+{
+    static TextureCache cache;
+    return cache;
+}
@@ -0,0 +1,93 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <cstdint>
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "texture_loader.hpp"
+
+struct TextureCacheStats
+{
+    unsigned int pathHits = 0;
+    // Different path, same file contents (copies, hard links that realpath does not merge)
+    unsigned int contentHits = 0;
+    unsigned int misses = 0;
+    unsigned int freed = 0;
+};
+
+// Process-wide 2D textures keyed by canonical path, then by a hash of the file contents, so
+// every model sharing an image shares one GL texture. Color and data uses of one image filter
+// their mips differently, so each content kind has its own keys. Each acquire adds a reference
+// and the texture is deleted when the last one is released. GL thread only.
+// The contents are hashed on the worker pool before anything is decoded, so a second path to
+// the same image is recognised as soon as its hash comes back: its decode is never queued, its
+// name becomes an alias of the first texture, and holders swap it for the real one with
+// settle().
+class TextureCache
+{
+public:
+    // Returns the texture for the file, reserving a name and queueing the read on a miss. The
+    // pixels arrive with the next uploadPending(), or the uploadReady() calls after they decode.
+    unsigned int acquire(const std::string& path, TextureContent content);
+    // Returns the texture a reference taken on textureID belongs to. If textureID turned out to
+    // be a copy, the reference moves to the original and textureID must not be used again.
+    unsigned int settle(unsigned int textureID);
+    // Takes settled and unsettled names alike
+    void release(unsigned int textureID);
+
+    // Waits for every queued texture and uploads it, returns how many there were
+    unsigned int uploadPending();
+    // Moves every texture on as far as its finished worker jobs allow (a read to a decode, a
+    // decode to an upload), stopping once budgetMs has passed after at least one finished, so a
+    // frame never waits on a worker; returns how many finished
+    unsigned int uploadReady(double budgetMs);
+    // Whether the texture is still waiting on its read, decode or upload
+    bool isPending(unsigned int textureID) const;
+
+    const TextureCacheStats& stats() const { return counters; }
+    unsigned int size() const { return static_cast<unsigned int>(entries.size()); }
+    void printStats() const;
+
+private:
+    struct Entry
+    {
+        unsigned int references;
+        TextureContent content;
+        uint64_t contentHash;
+        // Every canonical path that resolved to this texture
+        std::vector<std::string> paths;
+    };
+    // A name whose read found another texture's contents, kept until its references settle
+    struct Alias
+    {
+        unsigned int texture;
+        unsigned int references;
+    };
+
+    // A texture on its way in: its source read and hashed, then for an image its decode
+    struct Pending
+    {
+        unsigned int texture;
+        TextureContent content;
+        std::future<TextureSource> source;
+        std::future<DecodedImage> image;
+    };
+
+    // Indexed by TextureContent
+    std::unordered_map<std::string, unsigned int> byPath[2];
+    std::unordered_map<uint64_t, unsigned int> byContent[2];
+    std::unordered_map<unsigned int, Entry> entries;
+    std::unordered_map<unsigned int, Alias> aliases;
+    std::vector<Pending> pending;
+    TextureCacheStats counters;
+
+    bool advance(Pending& job, bool wait);
+    void alias(unsigned int textureID, unsigned int target);
+};
+
+TextureCache& textureCache();
+
+#endif
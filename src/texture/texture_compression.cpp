@@ -0,0 +1,646 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <sys/stat.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../util/thread_pool.hpp"
+#include "texture_compression.hpp"
+
+// Block layouts below are little endian, as is every host this builds for.
+
+static const char TEXTURE_CACHE_MAGIC[8] = { 'T', 'E', 'X', 'C', 'A', 'C', 'H', 'E' };
+static const uint32_t TEXTURE_CACHE_VERSION = 3;
+
+struct TextureCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t compression;
+    uint32_t mipFilter;
+    uint32_t content;
+    int64_t sourceMtime;
+    uint64_t sourceSize;
+    uint32_t internalFormat;
+    uint32_t levelCount;
+};
+
+struct TextureCacheLevel
+{
+    uint32_t width;
+    uint32_t height;
+    uint64_t size;
+};
+
+// BC7 interpolation weights out of 64 for 4 bit indices
+static const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static TextureCompression activeCompression = TEXTURE_COMPRESSION_NONE;
+
+// Index of the nearest palette entry (RGBA8) for each of the 16 pixels, by squared distance
+static void nearestPaletteIndices(const unsigned char* rgba, const unsigned char* palette, unsigned int paletteSize, unsigned char* indices)
+{
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (unsigned int group = 0; group < 4; group++)
+    {
+        // Four pixels widened to 16 bits per channel, two pixels per register
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + group * 16));
+        __m128i low = _mm_unpacklo_epi8(pixels, zero);
+        __m128i high = _mm_unpackhi_epi8(pixels, zero);
+
+        __m128i bestDistance = _mm_set1_epi32(0x7fffffff);
+        __m128i bestIndex = _mm_setzero_si128();
+        for (unsigned int i = 0; i < paletteSize; i++)
+        {
+            int packed;
+            std::memcpy(&packed, palette + i * 4, 4);
+            __m128i entry = _mm_unpacklo_epi8(_mm_set1_epi32(packed), zero);
+
+            // madd leaves r*r + g*g and b*b + a*a per pixel, then each pair is folded into one lane
+            __m128i lowDelta = _mm_sub_epi16(low, entry);
+            __m128i highDelta = _mm_sub_epi16(high, entry);
+            __m128i lowSquares = _mm_madd_epi16(lowDelta, lowDelta);
+            __m128i highSquares = _mm_madd_epi16(highDelta, highDelta);
+            lowSquares = _mm_add_epi32(lowSquares, _mm_srli_epi64(lowSquares, 32));
+            highSquares = _mm_add_epi32(highSquares, _mm_srli_epi64(highSquares, 32));
+            __m128i distance = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lowSquares), _mm_castsi128_ps(highSquares), _MM_SHUFFLE(2, 0, 2, 0)));
+
+            __m128i closer = _mm_cmplt_epi32(distance, bestDistance);
+            bestDistance = _mm_or_si128(_mm_and_si128(closer, distance), _mm_andnot_si128(closer, bestDistance));
+            bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(i)), _mm_andnot_si128(closer, bestIndex));
+        }
+
+        int lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), bestIndex);
+        for (unsigned int k = 0; k < 4; k++)
+            indices[group * 4 + k] = static_cast<unsigned char>(lanes[k]);
+    }
+#else
+    for (unsigned int p = 0; p < 16; p++)
+    {
+        int bestDistance = 0x7fffffff;
+        for (unsigned int i = 0; i < paletteSize; i++)
+        {
+            int distance = 0;
+            for (unsigned int c = 0; c < 4; c++)
+            {
+                int delta = rgba[p * 4 + c] - palette[i * 4 + c];
+                distance += delta * delta;
+            }
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                indices[p] = static_cast<unsigned char>(i);
+            }
+        }
+    }
+#endif
+}
+
+// Ends of the pixels' principal axis over the first channels, spanning every projection
+static void fitEndpoints(const unsigned char* rgba, unsigned int channels, float* low, float* high)
+{
+    float mean[4] = {};
+    float minimum[4] = { 255.0f, 255.0f, 255.0f, 255.0f };
+    float maximum[4] = {};
+    for (unsigned int p = 0; p < 16; p++)
+    {
+        for (unsigned int c = 0; c < channels; c++)
+        {
+            float value = rgba[p * 4 + c];
+            mean[c] += value;
+            minimum[c] = std::min(minimum[c], value);
+            maximum[c] = std::max(maximum[c], value);
+        }
+    }
+
+    float covariance[4][4] = {};
+    for (unsigned int c = 0; c < channels; c++)
+        mean[c] /= 16.0f;
+    for (unsigned int p = 0; p < 16; p++)
+    {
+        float delta[4];
+        for (unsigned int c = 0; c < channels; c++)
+            delta[c] = rgba[p * 4 + c] - mean[c];
+        for (unsigned int a = 0; a < channels; a++)
+            for (unsigned int b = 0; b < channels; b++)
+                covariance[a][b] += delta[a] * delta[b];
+    }
+
+    // Power iteration, starting from the bounding box diagonal
+    float axis[4] = {};
+    float length = 0.0f;
+    for (unsigned int c = 0; c < channels; c++)
+    {
+        axis[c] = maximum[c] - minimum[c];
+        length += axis[c] * axis[c];
+    }
+    if (length == 0.0f)
+    {
+        // Flat block
+        std::copy(mean, mean + channels, low);
+        std::copy(mean, mean + channels, high);
+        return;
+    }
+
+    for (unsigned int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        length = 0.0f;
+        for (unsigned int a = 0; a < channels; a++)
+        {
+            for (unsigned int b = 0; b < channels; b++)
+                next[a] += covariance[a][b] * axis[b];
+            length += next[a] * next[a];
+        }
+        if (length < 1e-12f)
+            break;
+
+        length = std::sqrt(length);
+        for (unsigned int c = 0; c < channels; c++)
+            axis[c] = next[c] / length;
+    }
+
+    length = 0.0f;
+    for (unsigned int c = 0; c < channels; c++)
+        length += axis[c] * axis[c];
+    length = std::sqrt(length);
+
+    float nearest = 0.0f, farthest = 0.0f;
+    for (unsigned int p = 0; p < 16; p++)
+    {
+        float t = 0.0f;
+        for (unsigned int c = 0; c < channels; c++)
+            t += (rgba[p * 4 + c] - mean[c]) * axis[c] / length;
+        nearest = std::min(nearest, t);
+        farthest = std::max(farthest, t);
+    }
+
+    for (unsigned int c = 0; c < channels; c++)
+    {
+        low[c] = std::min(std::max(mean[c] + axis[c] / length * nearest, 0.0f), 255.0f);
+        high[c] = std::min(std::max(mean[c] + axis[c] / length * farthest, 0.0f), 255.0f);
+    }
+}
+
+static uint16_t packRGB565(const float* color)
+{
+    unsigned int r = static_cast<unsigned int>(color[0] * 31.0f / 255.0f + 0.5f);
+    unsigned int g = static_cast<unsigned int>(color[1] * 63.0f / 255.0f + 0.5f);
+    unsigned int b = static_cast<unsigned int>(color[2] * 31.0f / 255.0f + 0.5f);
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(uint16_t color, unsigned char* rgba)
+{
+    unsigned int r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+    rgba[0] = static_cast<unsigned char>((r << 3) | (r >> 2));
+    rgba[1] = static_cast<unsigned char>((g << 2) | (g >> 4));
+    rgba[2] = static_cast<unsigned char>((b << 3) | (b >> 2));
+    rgba[3] = 255;
+}
+
+void encodeBC1Block(const unsigned char* rgba, unsigned char* block)
+{
+    // Alpha takes no part in the fit or the palette search
+    unsigned char opaque[64];
+    std::memcpy(opaque, rgba, sizeof(opaque));
+    for (unsigned int p = 0; p < 16; p++)
+        opaque[p * 4 + 3] = 255;
+
+    float low[4], high[4];
+    fitEndpoints(opaque, 3, low, high);
+
+    // color0 > color1 selects the four color mode
+    uint16_t color0 = packRGB565(high), color1 = packRGB565(low);
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    unsigned char palette[16];
+    unpackRGB565(color0, palette);
+    unpackRGB565(color1, palette + 4);
+    for (unsigned int c = 0; c < 3; c++)
+    {
+        palette[8 + c] = static_cast<unsigned char>((2 * palette[c] + palette[4 + c]) / 3);
+        palette[12 + c] = static_cast<unsigned char>((palette[c] + 2 * palette[4 + c]) / 3);
+    }
+    palette[11] = palette[15] = 255;
+
+    unsigned char indices[16] = {};
+    if (color0 != color1)
+        nearestPaletteIndices(opaque, palette, 4, indices);
+
+    uint32_t bits = 0;
+    for (unsigned int p = 0; p < 16; p++)
+        bits |= static_cast<uint32_t>(indices[p]) << (p * 2);
+
+    std::memcpy(block, &color0, 2);
+    std::memcpy(block + 2, &color1, 2);
+    std::memcpy(block + 4, &bits, 4);
+}
+
+void encodeBC3Block(const unsigned char* rgba, unsigned char* block)
+{
+    unsigned char alpha0 = 0, alpha1 = 255;
+    for (unsigned int p = 0; p < 16; p++)
+    {
+        alpha0 = std::max(alpha0, rgba[p * 4 + 3]);
+        alpha1 = std::min(alpha1, rgba[p * 4 + 3]);
+    }
+
+    // alpha0 > alpha1 selects eight evenly spaced steps: index 0 is alpha0, 1 is alpha1 and
+    // 2 to 7 step from alpha0 towards alpha1
+    uint64_t bits = 0;
+    if (alpha0 > alpha1)
+    {
+        for (unsigned int p = 0; p < 16; p++)
+        {
+            int weight = static_cast<int>((rgba[p * 4 + 3] - alpha1) * 7.0f / (alpha0 - alpha1) + 0.5f);
+            uint64_t index = weight == 7 ? 0 : weight == 0 ? 1 : 8 - weight;
+            bits |= index << (p * 3);
+        }
+    }
+
+    block[0] = alpha0;
+    block[1] = alpha1;
+    std::memcpy(block + 2, &bits, 6);
+    encodeBC1Block(rgba, block + 8);
+}
+
+struct BlockBits
+{
+    uint64_t words[2] = { 0, 0 };
+    unsigned int position = 0;
+
+    void write(uint32_t value, unsigned int count)
+    {
+        for (unsigned int i = 0; i < count; i++, position++)
+            words[position / 64] |= static_cast<uint64_t>((value >> i) & 1) << (position % 64);
+    }
+};
+
+// Nearest 7 bit endpoint plus the p-bit it shares as the lowest of 8 bits
+static void quantizeBC7Endpoint(const float* color, unsigned char* quantized, unsigned int& pBit)
+{
+    float bestError = 1e30f;
+    for (unsigned int p = 0; p < 2; p++)
+    {
+        unsigned char candidate[4];
+        float error = 0.0f;
+        for (unsigned int c = 0; c < 4; c++)
+        {
+            int q = static_cast<int>((color[c] - p) / 2.0f + 0.5f);
+            candidate[c] = static_cast<unsigned char>(std::min(std::max(q, 0), 127));
+            float delta = candidate[c] * 2 + p - color[c];
+            error += delta * delta;
+        }
+        if (error < bestError)
+        {
+            bestError = error;
+            pBit = p;
+            std::copy(candidate, candidate + 4, quantized);
+        }
+    }
+}
+
+void encodeBC7Block(const unsigned char* rgba, unsigned char* block)
+{
+    float low[4], high[4];
+    fitEndpoints(rgba, 4, low, high);
+
+    unsigned char endpoint0[4], endpoint1[4];
+    unsigned int pBit0, pBit1;
+    quantizeBC7Endpoint(low, endpoint0, pBit0);
+    quantizeBC7Endpoint(high, endpoint1, pBit1);
+
+    unsigned char palette[64];
+    for (unsigned int i = 0; i < 16; i++)
+    {
+        for (unsigned int c = 0; c < 4; c++)
+        {
+            int e0 = endpoint0[c] * 2 + pBit0, e1 = endpoint1[c] * 2 + pBit1;
+            palette[i * 4 + c] = static_cast<unsigned char>(((64 - BC7_WEIGHTS[i]) * e0 + BC7_WEIGHTS[i] * e1 + 32) >> 6);
+        }
+    }
+
+    unsigned char indices[16];
+    nearestPaletteIndices(rgba, palette, 16, indices);
+
+    // The first pixel's index is stored without its top bit, so it must be below 8
+    if (indices[0] >= 8)
+    {
+        std::swap_ranges(endpoint0, endpoint0 + 4, endpoint1);
+        std::swap(pBit0, pBit1);
+        for (unsigned int p = 0; p < 16; p++)
+            indices[p] = 15 - indices[p];
+    }
+
+    BlockBits bits;
+    bits.write(1 << 6, 7);
+    for (unsigned int c = 0; c < 4; c++)
+    {
+        bits.write(endpoint0[c], 7);
+        bits.write(endpoint1[c], 7);
+    }
+    bits.write(pBit0, 1);
+    bits.write(pBit1, 1);
+    bits.write(indices[0], 3);
+    for (unsigned int p = 1; p < 16; p++)
+        bits.write(indices[p], 4);
+
+    std::memcpy(block, bits.words, 16);
+}
+
+BlockFormat blockFormatFor(TextureCompression compression, int channels)
+{
+    if (compression == TEXTURE_COMPRESSION_BC7)
+        return BLOCK_FORMAT_BC7;
+    return channels == 4 ? BLOCK_FORMAT_BC3 : BLOCK_FORMAT_BC1;
+}
+
+GLenum blockInternalFormat(BlockFormat format)
+{
+    if (format == BLOCK_FORMAT_BC1)
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    if (format == BLOCK_FORMAT_BC3)
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    return GL_COMPRESSED_RGBA_BPTC_UNORM;
+}
+
+size_t blockBytes(BlockFormat format)
+{
+    return format == BLOCK_FORMAT_BC1 ? 8 : 16;
+}
+
+const char* textureFormatName(GLenum internalFormat)
+{
+    if (internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+        return "BC1";
+    if (internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+        return "BC3";
+    if (internalFormat == GL_COMPRESSED_RGBA_BPTC_UNORM)
+        return "BC7";
+    return "RGBA8";
+}
+
+static void encodeLevel(const unsigned char* rgba, unsigned int width, unsigned int height, BlockFormat format, unsigned char* out)
+{
+    size_t bytes = blockBytes(format);
+    unsigned int blocksPerRow = (width + 3) / 4;
+    unsigned int blockRows = (height + 3) / 4;
+
+    workerPool().parallelFor(blockRows, [&](unsigned int blockRow) {
+        unsigned char block[64];
+        unsigned char* rowOut = out + static_cast<size_t>(blockRow) * blocksPerRow * bytes;
+        for (unsigned int blockColumn = 0; blockColumn < blocksPerRow; blockColumn++)
+        {
+            // Blocks hanging over the edge repeat the last row and column
+            for (unsigned int y = 0; y < 4; y++)
+            {
+                unsigned int sourceY = std::min(blockRow * 4 + y, height - 1);
+                for (unsigned int x = 0; x < 4; x++)
+                {
+                    unsigned int sourceX = std::min(blockColumn * 4 + x, width - 1);
+                    std::memcpy(block + (y * 4 + x) * 4, rgba + (static_cast<size_t>(sourceY) * width + sourceX) * 4, 4);
+                }
+            }
+
+            unsigned char* blockOut = rowOut + blockColumn * bytes;
+            if (format == BLOCK_FORMAT_BC1)
+                encodeBC1Block(block, blockOut);
+            else if (format == BLOCK_FORMAT_BC3)
+                encodeBC3Block(block, blockOut);
+            else
+                encodeBC7Block(block, blockOut);
+        }
+    });
+}
+
+void buildMipChain(const unsigned char* pixels, int width, int height, int channels, TextureCompression compression, MipFilter filter,
+                   TextureContent content, MipChain& chain)
+{
+    // Widen to RGBA the way GL expands GL_RED, GL_RG and GL_RGB uploads
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    std::vector<unsigned char> level(pixelCount * 4), next;
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        const unsigned char* source = pixels + i * channels;
+        level[i * 4] = source[0];
+        level[i * 4 + 1] = channels > 1 ? source[1] : 0;
+        level[i * 4 + 2] = channels > 2 ? source[2] : 0;
+        level[i * 4 + 3] = channels > 3 ? source[3] : 255;
+    }
+
+    BlockFormat format = blockFormatFor(compression, channels);
+    chain.internalFormat = compression == TEXTURE_COMPRESSION_NONE ? GL_RGBA8 : blockInternalFormat(format);
+    chain.levels.clear();
+    chain.data.clear();
+
+    unsigned int levelWidth = width, levelHeight = height;
+    while (true)
+    {
+        MipLevel entry;
+        entry.width = levelWidth;
+        entry.height = levelHeight;
+        entry.offset = chain.data.size();
+        if (chain.compressed())
+            entry.size = static_cast<size_t>((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockBytes(format);
+        else
+            entry.size = level.size();
+        chain.data.resize(entry.offset + entry.size);
+        chain.levels.push_back(entry);
+
+        if (chain.compressed())
+            encodeLevel(level.data(), levelWidth, levelHeight, format, &chain.data[entry.offset]);
+        else
+            std::memcpy(&chain.data[entry.offset], level.data(), entry.size);
+
+        if (levelWidth == 1 && levelHeight == 1)
+            break;
+
+        unsigned int nextWidth = std::max(levelWidth / 2, 1u), nextHeight = std::max(levelHeight / 2, 1u);
+        next.resize(static_cast<size_t>(nextWidth) * nextHeight * 4);
+        downsampleLevel(level.data(), levelWidth, levelHeight, next.data(), filter, content);
+        level.swap(next);
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+    }
+}
+
+static bool statSource(const std::string& path, int64_t& mtime, uint64_t& size)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+
+    mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    size = st.st_size;
+    return true;
+}
+
+std::string textureCachePath(const std::string& sourcePath, TextureContent content)
+{
+    return sourcePath + (content == TEXTURE_CONTENT_DATA ? ".data.texcache" : ".texcache");
+}
+
+bool readMipChainCache(const std::string& sourcePath, TextureCompression compression, MipFilter filter, TextureContent content, MipChain& chain)
+{
+    int64_t mtime;
+    uint64_t size;
+    if (!statSource(sourcePath, mtime, size))
+        return false;
+
+    FILE* file = std::fopen(textureCachePath(sourcePath, content).c_str(), "rb");
+    if (!file)
+        return false;
+
+    TextureCacheHeader header;
+    bool fresh = std::fread(&header, sizeof(header), 1, file) == 1
+        && std::memcmp(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic)) == 0
+        && header.version == TEXTURE_CACHE_VERSION
+        && header.compression == static_cast<uint32_t>(compression)
+        && header.mipFilter == static_cast<uint32_t>(filter)
+        && header.content == static_cast<uint32_t>(content)
+        && header.sourceMtime == mtime
+        && header.sourceSize == size
+        && header.levelCount > 0 && header.levelCount <= 32;
+
+    std::vector<TextureCacheLevel> levels;
+    if (fresh)
+    {
+        levels.resize(header.levelCount);
+        fresh = std::fread(levels.data(), sizeof(TextureCacheLevel), levels.size(), file) == levels.size()
+            && levels.size() == mipLevelCount(levels[0].width, levels[0].height);
+    }
+
+    size_t total = 0;
+    if (fresh)
+    {
+        chain.internalFormat = header.internalFormat;
+        chain.levels.clear();
+        for (const TextureCacheLevel& level : levels)
+        {
+            chain.levels.push_back({ level.width, level.height, total, static_cast<size_t>(level.size) });
+            total += level.size;
+        }
+
+        chain.data.resize(total);
+        fresh = std::fread(chain.data.data(), 1, total, file) == total;
+    }
+
+    std::fclose(file);
+    if (!fresh)
+    {
+        chain.levels.clear();
+        chain.data.clear();
+    }
+    return fresh;
+}
+
+bool writeMipChainCache(const std::string& sourcePath, TextureCompression compression, MipFilter filter, TextureContent content, const MipChain& chain)
+{
+    TextureCacheHeader header;
+    std::memcpy(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic));
+    header.version = TEXTURE_CACHE_VERSION;
+    header.compression = compression;
+    header.mipFilter = filter;
+    header.content = content;
+    header.internalFormat = chain.internalFormat;
+    header.levelCount = chain.levels.size();
+    if (!statSource(sourcePath, header.sourceMtime, header.sourceSize))
+        return false;
+
+    std::vector<TextureCacheLevel> levels;
+    for (const MipLevel& level : chain.levels)
+        levels.push_back({ level.width, level.height, level.size });
+
+    // Write beside the final name and rename so readers never see a half written file
+    std::string path = textureCachePath(sourcePath, content);
+    std::string temporary = path + ".tmp";
+    FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file)
+    {
+        std::cout << "ERROR::TEXTURE_CACHE::CANNOT_WRITE " << temporary << std::endl;
+        return false;
+    }
+
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1
+        && std::fwrite(levels.data(), sizeof(TextureCacheLevel), levels.size(), file) == levels.size()
+        && std::fwrite(chain.data.data(), 1, chain.data.size(), file) == chain.data.size();
+    written = std::fclose(file) == 0 && written;
+    if (!written || std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::cout << "ERROR::TEXTURE_CACHE::CANNOT_WRITE " << path << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+static bool hasExtension(const char* name)
+{
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int i = 0; i < count; i++)
+    {
+        if (std::strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)), name) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool textureFormatSupported(GLenum internalFormat)
+{
+    if (internalFormat == GL_RGBA8 || internalFormat == GL_SRGB8_ALPHA8)
+        return true;
+
+    // S3TC is only usable with the extension, whatever the format query says
+    bool s3tc = internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+        || internalFormat == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT || internalFormat == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+    if (s3tc && !hasExtension("GL_EXT_texture_compression_s3tc"))
+        return false;
+
+    GLint supported = GL_FALSE;
+    glGetInternalformativ(GL_TEXTURE_2D, internalFormat, GL_INTERNALFORMAT_SUPPORTED, 1, &supported);
+    return supported == GL_TRUE;
+}
+
+static const char* compressionName(TextureCompression compression)
+{
+    if (compression == TEXTURE_COMPRESSION_BC)
+        return "bc";
+    if (compression == TEXTURE_COMPRESSION_BC7)
+        return "bc7";
+    return "none";
+}
+
+TextureCompression chooseTextureCompression(TextureCompression requested)
+{
+    TextureCompression chosen = requested;
+    if (chosen == TEXTURE_COMPRESSION_BC7 && !textureFormatSupported(GL_COMPRESSED_RGBA_BPTC_UNORM))
+        chosen = TEXTURE_COMPRESSION_BC;
+    if (chosen == TEXTURE_COMPRESSION_BC && !(textureFormatSupported(GL_COMPRESSED_RGB_S3TC_DXT1_EXT) && textureFormatSupported(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)))
+        chosen = TEXTURE_COMPRESSION_NONE;
+
+    if (chosen != requested)
+        std::cout << "Texture compression " << compressionName(requested) << " is not supported, using " << compressionName(chosen) << std::endl;
+    return chosen;
+}
+
+void setTextureCompression(TextureCompression compression)
+{
+    activeCompression = compression;
+}
+
+TextureCompression textureCompression()
+{
+    return activeCompression;
+}
@@ -0,0 +1,97 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mip_generator.hpp"
+
+// S3TC is an extension rather than core, so not every loader header carries its enums
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// How textures are stored on the GPU. BC picks BC1 for opaque images and BC3 where there
+// is alpha; BC7 is used for everything in its mode, at twice BC1's size but better quality.
+enum TextureCompression
+{
+    TEXTURE_COMPRESSION_NONE,
+    TEXTURE_COMPRESSION_BC,
+    TEXTURE_COMPRESSION_BC7
+};
+
+enum BlockFormat
+{
+    BLOCK_FORMAT_BC1,
+    BLOCK_FORMAT_BC3,
+    BLOCK_FORMAT_BC7
+};
+
+struct MipLevel
+{
+    unsigned int width;
+    unsigned int height;
+    size_t offset;
+    size_t size;
+};
+
+// A full mip chain down to 1x1, ready for upload: every level's blocks (or GL_RGBA8 texels
+// without compression) packed back to back in data.
+struct MipChain
+{
+    GLenum internalFormat = 0;
+    std::vector<MipLevel> levels;
+    std::vector<unsigned char> data;
+
+    bool compressed() const { return internalFormat != GL_RGBA8; }
+};
+
+// Encoders for one 4x4 block of RGBA8 pixels, rows top to bottom. BC1 ignores alpha.
+void encodeBC1Block(const unsigned char* rgba, unsigned char* block);
+void encodeBC3Block(const unsigned char* rgba, unsigned char* block);
+// Mode 6 only: one RGBA endpoint pair with 16 interpolation steps
+void encodeBC7Block(const unsigned char* rgba, unsigned char* block);
+
+BlockFormat blockFormatFor(TextureCompression compression, int channels);
+GLenum blockInternalFormat(BlockFormat format);
+size_t blockBytes(BlockFormat format);
+const char* textureFormatName(GLenum internalFormat);
+
+// Widens 1 to 4 channel 8 bit pixels to RGBA, generates every level with the filter and
+// encodes each for the compression mode. Both steps spread their rows over the worker pool.
+void buildMipChain(const unsigned char* pixels, int width, int height, int channels, TextureCompression compression, MipFilter filter,
+                   TextureContent content, MipChain& chain);
+
+// Mip chains are cached next to their source as "<source>.texcache" ("<source>.data.texcache"
+// for data content, so both uses of one image keep their cache), keyed by the source's mtime
+// and size, the compression mode, the filter and the content; a stale or corrupt cache is
+// ignored.
+std::string textureCachePath(const std::string& sourcePath, TextureContent content);
+bool readMipChainCache(const std::string& sourcePath, TextureCompression compression, MipFilter filter, TextureContent content, MipChain& chain);
+bool writeMipChainCache(const std::string& sourcePath, TextureCompression compression, MipFilter filter, TextureContent content, const MipChain& chain);
+
+// Whether the driver can sample the format (GL thread); uncompressed formats always pass
+bool textureFormatSupported(GLenum internalFormat);
+
+// Asks the driver for the formats the requested mode needs (GL thread), stepping down
+// from BC7 to BC to none until one is supported.
+TextureCompression chooseTextureCompression(TextureCompression requested);
+
+// Mode applied to every decode queued from now on
+void setTextureCompression(TextureCompression compression);
+TextureCompression textureCompression();
+
+#endif
@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+#include "../util/profiler.hpp"
+#include "../util/thread_pool.hpp"
+#include "texture_loader.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static bool readFile(const std::string& path, std::vector<unsigned char>& bytes)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+static uint64_t hashBytes(const std::vector<unsigned char>& bytes)
+{
+    // FNV-1a, 64 bit
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char byte : bytes)
+        hash = (hash ^ byte) * 1099511628211ull;
+    return hash;
+}
+
+static void reportTiming(const DecodedImage& image, double uploadMs)
+{
+    std::cout << "Texture " << image.path << " (" << image.width << "x" << image.height << " " << textureFormatName(image.mips.internalFormat)
+              << ", " << image.mips.levels.size() << " levels, " << image.mips.data.size() / 1024 << " KiB): ";
+    if (image.buildMs > 0.0)
+        std::cout << "decode " << image.decodeMs << " ms, mips " << image.buildMs << " ms, ";
+    else
+        std::cout << "cache read " << image.decodeMs << " ms, ";
+    std::cout << "upload " << uploadMs << " ms" << std::endl;
+}
+
+// Fills every level of storage already allocated on the target's texture
+static void uploadLevels(GLenum target, const MipChain& mips)
+{
+    for (unsigned int level = 0; level < mips.levels.size(); level++)
+    {
+        const MipLevel& entry = mips.levels[level];
+        if (mips.compressed())
+            glCompressedTexSubImage2D(target, level, 0, 0, entry.width, entry.height, mips.internalFormat, entry.size, &mips.data[entry.offset]);
+        else
+            glTexSubImage2D(target, level, 0, 0, entry.width, entry.height, GL_RGBA, GL_UNSIGNED_BYTE, &mips.data[entry.offset]);
+    }
+}
+
+static void setTexture2DSampling()
+{
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+// Allocates storage on the bound target and uploads every level and face of the mapped file
+static bool uploadKtx2(GLenum target, const Ktx2File& file, const std::string& path, unsigned int faceCount, const char* timing, Clock::time_point start)
+{
+    if (file.faceCount() != faceCount)
+    {
+        std::cout << "ERROR::KTX::EXPECTED_" << faceCount << "_FACES " << path << std::endl;
+        return false;
+    }
+    if (!textureFormatSupported(file.internalFormat()))
+    {
+        std::cout << "KTX2 texture " << path << " is " << textureFormatName(file.internalFormat()) << ", which the driver cannot sample" << std::endl;
+        return false;
+    }
+
+    bool compressed = file.internalFormat() != GL_RGBA8 && file.internalFormat() != GL_SRGB8_ALPHA8;
+    glTexStorage2D(target, file.levelCount(), file.internalFormat(), file.width(), file.height());
+    for (unsigned int level = 0; level < file.levelCount(); level++)
+    {
+        unsigned int width = std::max(file.width() >> level, 1u), height = std::max(file.height() >> level, 1u);
+        for (unsigned int face = 0; face < faceCount; face++)
+        {
+            GLenum faceTarget = faceCount == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target;
+            if (compressed)
+                glCompressedTexSubImage2D(faceTarget, level, 0, 0, width, height, file.internalFormat(), file.imageSize(level), file.imageData(level, face));
+            else
+                glTexSubImage2D(faceTarget, level, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, file.imageData(level, face));
+        }
+    }
+    // The file may stop short of 1x1
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, file.levelCount() - 1);
+
+    std::cout << "Texture " << path << " (" << file.width() << "x" << file.height() << " " << textureFormatName(file.internalFormat()) << ", "
+              << file.levelCount() << " levels, " << faceCount << (faceCount == 1 ? " face" : " faces") << (file.supercompressed() ? ", KTX2 zstd): " : ", KTX2): ")
+              << timing << " " << millisecondsSince(start) << " ms" << std::endl;
+    return true;
+}
+
+bool uploadKtx2Texture2D(unsigned int textureID, const Ktx2File& file, const std::string& path)
+{
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    if (!uploadKtx2(GL_TEXTURE_2D, file, path, 1, "upload", Clock::now()))
+        return false;
+
+    setTexture2DSampling();
+    return true;
+}
+
+bool uploadKtx2Cubemap(const std::string& path)
+{
+    Clock::time_point start = Clock::now();
+    Ktx2File file;
+    if (!file.open(path))
+        return false;
+    return uploadKtx2(GL_TEXTURE_CUBE_MAP, file, path, 6, "map and upload", start);
+}
+
+// Worker side of a decode: the cached mip chain when it is fresh, otherwise stb_image, the
+// filtered and encoded chain, and a write back to the cache
+static DecodedImage decodeImage(const std::string& path, const std::vector<unsigned char>* fileBytes, TextureCompression compression, MipFilter filter,
+                               TextureContent content)
+{
+    PROFILE_ZONE("decodeImage");
+    Clock::time_point start = Clock::now();
+
+    DecodedImage image;
+    image.path = path;
+    if (readMipChainCache(path, compression, filter, content, image.mips))
+    {
+        image.width = image.mips.levels[0].width;
+        image.height = image.mips.levels[0].height;
+        image.decodeMs = millisecondsSince(start);
+        return image;
+    }
+
+    int channels;
+    unsigned char* pixels;
+    if (fileBytes)
+        pixels = stbi_load_from_memory(fileBytes->data(), static_cast<int>(fileBytes->size()), &image.width, &image.height, &channels, 0);
+    else
+        pixels = stbi_load(path.c_str(), &image.width, &image.height, &channels, 0);
+    image.decodeMs = millisecondsSince(start);
+    if (!pixels)
+        return image;
+
+    {
+        PROFILE_ZONE("buildMipChain");
+        start = Clock::now();
+        buildMipChain(pixels, image.width, image.height, channels, compression, filter, content, image.mips);
+        stbi_image_free(pixels);
+        writeMipChainCache(path, compression, filter, content, image.mips);
+        image.buildMs = millisecondsSince(start);
+    }
+    return image;
+}
+
+std::future<DecodedImage> decodeImageAsync(const std::string& path, TextureContent content)
+{
+    TextureCompression compression = textureCompression();
+    MipFilter filter = mipFilter();
+    return workerPool().submit([path, compression, filter, content]() {
+        return decodeImage(path, nullptr, compression, filter, content);
+    });
+}
+
+std::future<TextureSource> readTextureSourceAsync(const std::string& path, bool tryKtx2)
+{
+    return workerPool().submit([path, tryKtx2]() {
+        PROFILE_ZONE("readTextureSource");
+        TextureSource source;
+        source.path = path;
+        if (tryKtx2)
+        {
+            std::unique_ptr<Ktx2File> file(new Ktx2File());
+            if (file->open(ktx2PathFor(path)))
+            {
+                source.ktx2 = std::move(file);
+                return source;
+            }
+        }
+        if (readFile(path, source.bytes))
+            source.contentHash = hashBytes(source.bytes);
+        return source;
+    });
+}
+
+std::future<DecodedImage> decodeSourceAsync(TextureSource& source, TextureContent content)
+{
+    TextureCompression compression = textureCompression();
+    MipFilter filter = mipFilter();
+    std::string path = source.path;
+    std::shared_ptr<std::vector<unsigned char>> bytes = std::make_shared<std::vector<unsigned char>>(std::move(source.bytes));
+    return workerPool().submit([path, bytes, compression, filter, content]() {
+        return decodeImage(path, bytes->empty() ? nullptr : bytes.get(), compression, filter, content);
+    });
+}
+
+void freeImage(DecodedImage& image)
+{
+    image.mips = MipChain();
+}
+
+void uploadTexture2D(unsigned int textureID, DecodedImage& image)
+{
+    if (image.mips.levels.empty())
+    {
+        std::cout << "Texture failed to load at path: " << image.path << std::endl;
+        return;
+    }
+
+    Clock::time_point start = Clock::now();
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexStorage2D(GL_TEXTURE_2D, image.mips.levels.size(), image.mips.internalFormat, image.width, image.height);
+    uploadLevels(GL_TEXTURE_2D, image.mips);
+    setTexture2DSampling();
+
+    reportTiming(image, millisecondsSince(start));
+    freeImage(image);
+}
+
+bool allocateCubemapStorage(const DecodedImage& face)
+{
+    if (face.mips.levels.empty())
+        return false;
+
+    glTexStorage2D(GL_TEXTURE_CUBE_MAP, face.mips.levels.size(), face.mips.internalFormat, face.width, face.height);
+    return true;
+}
+
+void uploadCubemapFace(unsigned int face, DecodedImage& image)
+{
+    if (image.mips.levels.empty())
+    {
+        std::cout << "Cubemap tex failed to load at path: " << image.path << std::endl;
+        return;
+    }
+
+    Clock::time_point start = Clock::now();
+    uploadLevels(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, image.mips);
+
+    reportTiming(image, millisecondsSince(start));
+    freeImage(image);
+}
@@ -0,0 +1,70 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ktx_texture.hpp"
+#include "texture_compression.hpp"
+
+// An image decoded on a worker thread, waiting for upload on the GL thread: the full mip
+// chain, block compressed unless compression is off, either built from the decoded pixels
+// or read back from the chain cached next to the source.
+struct DecodedImage
+{
+    std::string path;
+    int width = 0;
+    int height = 0;
+    double decodeMs = 0.0;
+    MipChain mips;
+    // Zero when the chain came from the on-disk cache
+    double buildMs = 0.0;
+};
+
+// First stage of a 2D texture load, read on a worker thread before anything is decoded: the
+// converted KTX2 beside the image, mapped and checked, or else the image file itself, read
+// whole and hashed so copies of one image are found before any of them is decoded.
+struct TextureSource
+{
+    std::string path;
+    // Set when a usable KTX2 was found; the driver has yet to be asked about its format
+    std::unique_ptr<Ktx2File> ktx2;
+    std::vector<unsigned char> bytes;
+    // FNV-1a of bytes; zero with a KTX2 or if the image is unreadable
+    uint64_t contentHash = 0;
+};
+
+// Queues a decode on the worker pool, in the compression and mip filter set at the time of the
+// call, with the mips filtered as the content says. The result must be released with freeImage
+// (the upload helpers do).
+std::future<DecodedImage> decodeImageAsync(const std::string& path, TextureContent content);
+// Queues the first stage of a load for the image at path; tryKtx2 false skips straight to
+// the image, for a KTX2 the driver turned out not to sample.
+std::future<TextureSource> readTextureSourceAsync(const std::string& path, bool tryKtx2);
+// Queues the decode of an image source from the bytes it already holds, which it takes.
+std::future<DecodedImage> decodeSourceAsync(TextureSource& source, TextureContent content);
+void freeImage(DecodedImage& image);
+
+// Gives an existing 2D texture name immutable storage for the whole chain, uploads every level
+// and sets repeat wrapping and mipmapped filtering, then frees the image.
+void uploadTexture2D(unsigned int textureID, DecodedImage& image);
+// Immutable storage on the currently bound cubemap, sized and formatted after one face; false
+// if that face failed to load.
+bool allocateCubemapStorage(const DecodedImage& face);
+// Uploads every level of one face of the currently bound cubemap, then frees the image.
+void uploadCubemapFace(unsigned int face, DecodedImage& image);
+
+// KTX2 files need no decode, so they upload straight from the mapped file. Both return false
+// without touching the texture if the file is unusable (or, for the cubemap, missing) or in a
+// format the driver cannot sample, leaving the caller to fall back to the source images.
+// The 2D texture gets the same sampling state as uploadTexture2D.
+bool uploadKtx2Texture2D(unsigned int textureID, const Ktx2File& file, const std::string& path);
+// Storage and all six faces of the currently bound cubemap
+bool uploadKtx2Cubemap(const std::string& path);
+
+#endif
@@ -0,0 +1,134 @@
+// Offline converter from the source images to KTX2, so the renderer can upload finished mip
+// chains straight from disk instead of decoding, filtering and compressing at load time.
+//
+//   ktx_convert [options] <image>...                    writes <stem>.ktx2 beside each image
+//   ktx_convert [options] --cubemap <out.ktx2> <6 faces>  faces in +X, -X, +Y, -Y, +Z, -Z order
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../stb_image.h"
+#include "../texture/ktx_texture.hpp"
+#include "../texture/texture_compression.hpp"
+
+struct ConvertOptions
+{
+    TextureCompression compression = TEXTURE_COMPRESSION_BC;
+    MipFilter filter = MIP_FILTER_KAISER;
+    TextureContent content = TEXTURE_CONTENT_COLOR;
+    int zstdLevel = 0;
+    std::string cubemapPath;
+    std::vector<std::string> inputs;
+};
+
+static void printUsage(const char* program)
+{
+    std::cout << "Usage: " << program << " [options] <image>...\n"
+              << "       " << program << " [options] --cubemap <out.ktx2> <+x> <-x> <+y> <-y> <+z> <-z>\n"
+              << "  --compression <mode>  bc (default, BC1 or BC3 with alpha), bc7, or none for raw RGBA\n"
+              << "  --mip-filter <filter> kaiser (default) or box\n"
+              << "  --data                filter the mips as plain values (specular maps) rather than sRGB color\n"
+              << "  --zstd <level>        supercompress every level with Zstandard at this level (1-22)\n"
+              << "Each image is written as <stem>.ktx2 beside it.\n";
+}
+
+static bool parseArguments(int argc, char** argv, ConvertOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--compression" && hasValue)
+        {
+            std::string mode = argv[++i];
+            if (mode == "none")
+                options.compression = TEXTURE_COMPRESSION_NONE;
+            else if (mode == "bc")
+                options.compression = TEXTURE_COMPRESSION_BC;
+            else if (mode == "bc7")
+                options.compression = TEXTURE_COMPRESSION_BC7;
+            else
+                return false;
+        }
+        else if (arg == "--mip-filter" && hasValue)
+        {
+            std::string filter = argv[++i];
+            if (filter == "kaiser")
+                options.filter = MIP_FILTER_KAISER;
+            else if (filter == "box")
+                options.filter = MIP_FILTER_BOX;
+            else
+                return false;
+        }
+        else if (arg == "--data")
+            options.content = TEXTURE_CONTENT_DATA;
+        else if (arg == "--zstd" && hasValue)
+        {
+            options.zstdLevel = std::atoi(argv[++i]);
+            if (options.zstdLevel < 1 || options.zstdLevel > 22)
+                return false;
+        }
+        else if (arg == "--cubemap" && hasValue)
+            options.cubemapPath = argv[++i];
+        else if (arg.compare(0, 2, "--") == 0)
+            return false;
+        else
+            options.inputs.push_back(arg);
+    }
+
+    if (options.inputs.empty())
+        return false;
+    return options.cubemapPath.empty() || options.inputs.size() == 6;
+}
+
+static bool loadChain(const std::string& path, const ConvertOptions& options, MipChain& chain)
+{
+    int width, height, channels;
+    unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &channels, 0);
+    if (!pixels)
+    {
+        std::cout << "ERROR::KTX_CONVERT::LOAD_FAILED " << path << std::endl;
+        return false;
+    }
+
+    buildMipChain(pixels, width, height, channels, options.compression, options.filter, options.content, chain);
+    stbi_image_free(pixels);
+    return true;
+}
+
+static bool convert(const std::vector<std::string>& inputs, const std::string& output, const ConvertOptions& options)
+{
+    std::vector<MipChain> chains(inputs.size());
+    for (unsigned int i = 0; i < inputs.size(); i++)
+    {
+        if (!loadChain(inputs[i], options, chains[i]))
+            return false;
+    }
+    if (!writeKtx2(output, chains, options.zstdLevel))
+        return false;
+
+    std::cout << output << ": " << chains[0].levels[0].width << "x" << chains[0].levels[0].height << " "
+              << textureFormatName(chains[0].internalFormat) << ", " << chains[0].levels.size() << " levels" << std::endl;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    ConvertOptions options;
+    if (!parseArguments(argc, argv, options))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (!options.cubemapPath.empty())
+        return convert(options.inputs, options.cubemapPath, options) ? 0 : 1;
+
+    bool ok = true;
+    for (const std::string& input : options.inputs)
+        ok = convert(std::vector<std::string>(1, input), ktx2PathFor(input), options) && ok;
+    return ok ? 0 : 1;
+}
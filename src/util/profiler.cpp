@@ -0,0 +1,135 @@
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "profiler.hpp"
+
+struct ProfileEvent
+{
+    const char* name;
+    long long start;
+    long long duration;
+};
+
+// Owned by the registry rather than the thread, so zones from finished threads still export
+struct ThreadBuffer
+{
+    unsigned int id;
+    std::string name;
+    std::mutex mutex;
+    std::vector<ProfileEvent> events;
+};
+
+static std::atomic<bool> enabled(false);
+static std::mutex registryMutex;
+static std::vector<std::shared_ptr<ThreadBuffer>> registry;
+static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+static long long nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+static ThreadBuffer& threadBuffer()
+{
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+    if (!buffer)
+    {
+        buffer = std::make_shared<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffer->id = registry.size();
+        buffer->name = "thread " + std::to_string(buffer->id);
+        registry.push_back(buffer);
+    }
+    return *buffer;
+}
+
+void setProfilerEnabled(bool on)
+{
+    enabled.store(on, std::memory_order_relaxed);
+}
+
+bool profilerEnabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void setProfilerThreadName(const std::string& name)
+{
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.name = name;
+}
+
+ProfileZone::ProfileZone(const char* name)
+    : name(name), start(profilerEnabled() ? nowNs() : -1)
+{
+}
+
+ProfileZone::~ProfileZone()
+{
+    // Zones that started while disabled are dropped, so toggling never leaves half a zone
+    if (start < 0 || !profilerEnabled())
+        return;
+
+    long long end = nowNs();
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events.push_back({ name, start, end - start });
+}
+
+static void writeJsonString(std::ofstream& file, const char* text)
+{
+    file << '"';
+    for (const char* c = text; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            file << '\\';
+        if ((unsigned char)*c >= 0x20)
+            file << *c;
+    }
+    file << '"';
+}
+
+bool writeChromeTrace(const std::string& path)
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cout << "ERROR::PROFILER::FILE_NOT_WRITTEN " << path << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> registryLock(registryMutex);
+    size_t eventCount = 0;
+    bool first = true;
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    for (const std::shared_ptr<ThreadBuffer>& buffer : registry)
+    {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+
+        file << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->id << ",\"args\":{\"name\":";
+        writeJsonString(file, buffer->name.c_str());
+        file << "}}";
+        first = false;
+
+        // Complete events, timestamps in microseconds
+        for (const ProfileEvent& event : buffer->events)
+        {
+            file << ",\n{\"ph\":\"X\",\"name\":";
+            writeJsonString(file, event.name);
+            file << ",\"pid\":1,\"tid\":" << buffer->id << ",\"ts\":" << event.start / 1000 << '.' << (event.start % 1000) / 100
+                 << ",\"dur\":" << event.duration / 1000 << '.' << (event.duration % 1000) / 100 << '}';
+        }
+        eventCount += buffer->events.size();
+    }
+
+    file << "\n]}\n";
+    std::cout << "Wrote " << eventCount << " profiler zones to " << path << std::endl;
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+
+// CPU zone profiler, compiled into every build and off until enabled at runtime. Each thread
+// appends finished zones to its own buffer, so recording never contends across threads;
+// a disabled zone costs one relaxed atomic load. Zone names must be string literals.
+// Build with -DDISABLE_PROFILER to compile the zones out entirely.
+
+void setProfilerEnabled(bool enabled);
+bool profilerEnabled();
+
+// Label for the calling thread in the exported trace, e.g. "main" or "worker 3"
+void setProfilerThreadName(const std::string& name);
+
+// Writes every recorded zone as Chrome trace_event JSON, viewable in chrome://tracing or
+// Perfetto. Call when other threads are idle; zones still open are not included.
+bool writeChromeTrace(const std::string& path);
+
+class ProfileZone
+{
+public:
+    explicit ProfileZone(const char* name);
+    ~ProfileZone();
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* name;
+    long long start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef DISABLE_PROFILER
+#define PROFILE_ZONE(name)
+#else
+// Times the rest of the enclosing scope
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#endif
+
+#endif
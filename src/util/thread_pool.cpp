@@ -0,0 +1,98 @@
+#include <algorithm>
+
+#include "thread_pool.hpp"
+#include "profiler.hpp"
+
+ThreadPool::ThreadPool(unsigned int threadCount) : stopping(false)
+{
+    if (threadCount == 0)
+        threadCount = 1;
+
+    for (unsigned int i = 0; i < threadCount; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+void ThreadPool::workerLoop(unsigned int index)
+{
+    setProfilerThreadName("worker " + std::to_string(index));
+
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty())
+                return;
+
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(unsigned int count, const std::function<void(unsigned int)>& body)
+{
+    struct Loop
+    {
+        std::atomic<unsigned int> next{ 0 };
+        std::atomic<unsigned int> done{ 0 };
+        unsigned int count;
+        const std::function<void(unsigned int)>* body;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    auto loop = std::make_shared<Loop>();
+    loop->count = count;
+    loop->body = &body;
+
+    // A helper that only starts after the loop is over finds no index left and never touches body
+    auto run = [loop]() {
+        unsigned int index;
+        while ((index = loop->next++) < loop->count)
+        {
+            (*loop->body)(index);
+            if (++loop->done == loop->count)
+            {
+                std::lock_guard<std::mutex> lock(loop->mutex);
+                loop->finished.notify_all();
+            }
+        }
+    };
+
+    unsigned int helpers = count > 1 ? std::min(count - 1, size()) : 0;
+    if (helpers > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (unsigned int i = 0; i < helpers; i++)
+                tasks.push(run);
+        }
+        condition.notify_all();
+    }
+
+    run();
+
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->finished.wait(lock, [&loop]() { return loop->done == loop->count; });
+}
+
+ThreadPool& workerPool()
+{
+    static ThreadPool pool(std::thread::hardware_concurrency());
+    return pool;
+}
@@ -0,0 +1,58 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling tasks from a shared queue. Tasks must not touch GL.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned int threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template <typename F>
+    auto submit(F&& task) -> std::future<decltype(task())>
+    {
+        using Result = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push([packaged]() { (*packaged)(); });
+        }
+        condition.notify_one();
+        return result;
+    }
+
+    // Runs body(0) to body(count - 1) on the calling thread and whichever workers are idle, and
+    // returns once every call has finished. The caller never waits on a task still in the queue,
+    // so this is safe from inside a task even when every worker is busy.
+    void parallelFor(unsigned int count, const std::function<void(unsigned int)>& body);
+
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+
+    void workerLoop(unsigned int index);
+};
+
+// Process-wide pool with one worker per hardware thread.
+ThreadPool& workerPool();
+
+#endif